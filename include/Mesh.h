@@ -1,6 +1,7 @@
 #include <Eigen/Dense>
 #include <Eigen/Sparse>
 #include <chrono>
+#include <cstdint>
 #include <map>
 #include <set>
 #include <string>
@@ -19,6 +20,9 @@
 //! /////////
 
 #include "configParser.h"
+#include "simdKernels.h"
+#include "solutionField.h"
+#include "spatialIndex.h"
 #include "utils.h"
 
 //! VTK headers
@@ -39,7 +43,7 @@ class Mesh
 {
 
 public:
-    Mesh(Config config);
+    Mesh(const Config &config);
 
     /**
      * List of getters used for vector access and to improve readability.
@@ -64,13 +68,20 @@ public:
     {
         return m_elNodeTags[el * m_elNumNodes + n];
     };
+    inline double &elNodeCoord(size_t el, int n = 0, int x = 0)
+    {
+        return m_nodeCoords[(el * m_elNumNodes + n) * 3 + x];
+    };
     inline double &elJacobian(size_t el, int g = 0, int x = 0, int u = 0)
     {
         return m_elJacobians[el * m_elNumIntPts * 9 + g * 9 + u * 3 + x];
     };
+    // Constant over an affine element: g is only used for the curved ones
     inline double &elJacobianDet(size_t el, int g = 0)
     {
-        return m_elJacobianDets[el * m_elNumIntPts + g];
+        if (elIsAffine(el))
+            return m_elJacobianDets[el];
+        return m_elCurvedJacobianDets[m_elCurvedIds[el] * m_elNumIntPts + g];
     };
     inline double &elWeight(int g)
     {
@@ -84,9 +95,17 @@ public:
     {
         return m_elUGradBasisFcts[g * m_elNumNodes * 3 + i * 3 + u];
     };
+    inline double &elInvJacobian(size_t el, int u = 0, int x = 0)
+    {
+        return m_elInvJacobians[el * 9 + u * 3 + x];
+    };
+    inline bool elIsAffine(size_t el)
+    {
+        return m_elCurvedIds[el] < 0;
+    };
     inline double &elGradBasisFct(size_t el, int g = 0, int i = 0, int x = 0)
     {
-        return m_elGradBasisFcts[el * m_elNumIntPts * m_elNumNodes * 3 + g * m_elNumNodes * 3 + i * 3 + x];
+        return m_elGradBasisFcts[m_elCurvedIds[el] * m_elNumIntPts * m_elNumNodes * 3 + g * m_elNumNodes * 3 + i * 3 + x];
     };
     inline size_t &elFNodeTag(size_t el, int f = 0, int i = 0)
     {
@@ -148,29 +167,83 @@ public:
     {
         return m_fBiTangents[f * 3 * m_fNumIntPts + g * 3 + x];
     };
-    inline size_t &elFId(size_t el, int f = 0)
+    inline uint32_t &elFId(size_t el, int f = 0)
     {
         return m_elFIds[el * m_fNumPerEl + f];
     }
-    inline size_t &fNbrElId(int f, size_t el = 0)
+    inline uint32_t &fNbrElId(int f, int side = 0)
     {
-        return m_fNbrElIds[f][el];
+        return m_fNbrElIds[f * 2 + side];
     }
-    inline size_t &fNToElNId(int f, int nf = 0, size_t el = 0)
+    inline uint32_t &fNToElNId(int f, int nf = 0, int side = 0)
     {
-        return m_fNToElNIds[f][nf * m_fNbrElIds[f].size() + el];
+        return m_fNToElNIds[(f * m_fNumNodes + nf) * 2 + side];
     }
     inline int &elFOrientation(size_t el, int f)
     {
         return m_elFOrientation[el * m_fNumPerEl + f];
     }
+    // Inscribed radius of an element and largest wave speed (stable time step)
+    inline double elInRadius(size_t el)
+    {
+        return m_elInRadius[el];
+    }
+    inline double getWaveSpeed()
+    {
+        return m_waveSpeed;
+    }
+    /**
+     * Inverse mass matrix of an element, up to the factor elMassScale(el):
+     * the shared reference inverse for the affine elements, the element
+     * own inverse for the curved ones.
+     */
     inline double &elMassMatrix(size_t el, int i = 0, int j = 0)
     {
-        return m_elMassMatrices[el * m_elNumNodes * m_elNumNodes + i * m_elNumNodes + j];
+        if (elIsAffine(el))
+            return m_refMassMatrix[i * m_elNumNodes + j];
+        return m_elMassMatrices[m_elCurvedIds[el] * m_elNumNodes * m_elNumNodes + i * m_elNumNodes + j];
+    }
+    inline double &refMassMatrix(int i = 0, int j = 0)
+    {
+        return m_refMassMatrix[i * m_elNumNodes + j];
+    }
+    inline double elMassScale(size_t el)
+    {
+        return elIsAffine(el) ? 1.0 / m_elJacobianDets[el] : 1.0;
+    }
+    /**
+     * Y = beta*Y + alpha*M^-1*X with the inverse mass matrix of an element
+     * (elMassMatrix), alpha includes elMassScale(el).
+     */
+    inline void elMassUpdate(size_t el, const double *X, double *Y, double alpha, double beta)
+    {
+        (this->*m_elMassKernel)(el, X, Y, alpha, beta);
     }
-    inline double &fFlux(int f, int n = 0)
+    inline double &fluxJacobian(int x, int eq = 0, int k = 0)
     {
-        return m_fFlux[f * m_fNumNodes + n];
+        return m_fluxJacobians[x * 16 + eq * 4 + k];
+    }
+    /**
+     * Physical flux (x, y, z) of an equation at a node, computed from u
+     * with the flux jacobians (the nodal fluxes are never stored).
+     */
+    inline void getPhysFlux(SolutionField &u, size_t n, int eq, double *F)
+    {
+        if (m_quiescent)
+        {
+            // Zero mean flow: F_p,x = rho0*c0^2 * v_x and F_vx,x = p / rho0
+            for (int x = 0; x < 3; ++x)
+                F[x] = (eq == 0) ? fluxJacobian(x, 0, 1 + x) * u[1 + x][n]
+                                 : (x == eq - 1) ? fluxJacobian(x, eq, 0) * u[0][n] : 0.0;
+            return;
+        }
+        for (int x = 0; x < 3; ++x)
+            F[x] = fluxJacobian(x, eq, 0) * u[0][n] + fluxJacobian(x, eq, 1) * u[1][n] +
+                   fluxJacobian(x, eq, 2) * u[2][n] + fluxJacobian(x, eq, 3) * u[3][n];
+    }
+    inline double &fFlux(int f, int eq = 0, int g = 0)
+    {
+        return m_fFlux[(f * 4 + eq) * m_fNumIntPts + g];
     }
 
     /**
@@ -184,48 +257,123 @@ public:
     {
         return m_elNumNodes;
     }
+    int getElDim()
+    {
+        return m_elDim;
+    }
+    int getElOrder()
+    {
+        return m_elOrder;
+    }
     int getElNum()
     {
         return m_elNum;
     }
+    int getFNumPerEl()
+    {
+        return m_fNumPerEl;
+    }
     std::vector<size_t> const &getElNodeTags()
     {
         return m_elNodeTags;
     }
+    std::vector<double> const &getNodeCoords()
+    {
+        return m_nodeCoords;
+    }
+    SpatialIndex const &getSpatialIndex()
+    {
+        return m_spatialIndex;
+    }
+    bool isQuiescent()
+    {
+        return m_quiescent;
+    }
+    simd::Isa getSimdIsa()
+    {
+        return m_simdIsa;
+    }
+    simd::AffineUpdateKernel getAffineUpdateKernel()
+    {
+        return m_affineUpdate;
+    }
 
     /**
      * Matrices and vectors assembly
      */
     void getElMassMatrix(size_t el, bool inverse, double *elMassMatrix);
     void precomputeMassMatrix();
-    void precomputeFlux(std::vector<double> &u, std::vector<std::vector<double>> &Flux, int eq);
-    void getElFlux(size_t el, double *F);
-    void getUniqueFaceNodeTags();
-    void getConnectivityFaceToElement();
-    // void getUniqueFaceNodeTags_test();
-    void getElStiffVector(size_t el, std::vector<std::vector<double>> &Flux,
-                          std::vector<double> &u, double *elStiffVector);
-    void updateFlux(std::vector<std::vector<double>> &u, std::vector<std::vector<std::vector<double>>> &Flux,
-                    std::vector<double> &v0, double c0, double rho0);
+    void precomputeDiffMatrices();
+    void precomputeLiftMatrix();
+    void precomputeFluxJacobians();
+    void precomputeInRadii();
+    void precomputeFlux(SolutionField &u);
+    void precomputeFlux(SolutionField &u, int numThreads);
+    void precomputeFluxShared(SolutionField &u);
+    void precomputeFluxShared(SolutionField &u, int maxLevel);
+    inline void getElFlux(size_t el, double *F)
+    {
+        (this->*m_elFluxKernel)(el, F);
+    }
+    void buildFaceTopology();
+    void getElStiffVector(size_t el, SolutionField &u, int eq, double *elStiffVector);
+    void getBlockStiffVectors(size_t el0, int numEl, SolutionField &u,
+                              int eq, double *blockStiffVectors);
+    void getAffineBatch(size_t el0, int numEl, SolutionField &u, simd::AffineBatch &batch);
+    void updateFlux(SolutionField &u);
+    void updateFluxShared(SolutionField &u);
+    void updateFluxShared(SolutionField &u, int maxLevel);
+    void setTimeLevels(std::vector<int> const &elLevel, int numLevels);
 
     /**
      * @brief Write VTK
      * Added by Sofiane KHELLADI in 11/03/2022
      */
-    // void writeVTU(std::string filename, std::vector<std::vector<double>> &u);
-    void writeVTUb(std::string filename, std::vector<std::vector<double>> &u);
-    void writePVD(std::string filename);
+    // void writeVTU(std::string filename, SolutionField &u);
+    void writeVTUb(std::string filename, SolutionField &u);
+    void writePVD(std::string filename, std::vector<std::pair<int, double>> const &outputs);
 
 private:
+    /**
+     * Preprocessing from the Gmsh model and binary mesh cache (see meshCache.h)
+     */
+    void build();
+    std::vector<uint32_t> mortonOrder();
+    bool loadCache(std::string fileName);
+    void saveCache(std::string fileName);
+    template <typename Stream>
+    void serialize(Stream &s);
+
+    /**
+     * Element kernels, specialized at compile time on the number of nodes
+     * of the element and of its faces (0 = generic, runtime sizes).
+     * The instantiations are selected at construction by selectKernels.
+     */
+    typedef void (Mesh::*ElFluxKernel)(size_t el, double *F);
+    typedef void (Mesh::*ElMassKernel)(size_t el, const double *X, double *Y, double alpha, double beta);
+    void selectKernels();
+    template <int FNN, int FNUM>
+    void getElFluxImpl(size_t el, double *F);
+    template <int NN>
+    void elMassUpdateImpl(size_t el, const double *X, double *Y, double alpha, double beta);
+    template <bool QUIESCENT>
+    void precomputeFluxImpl(SolutionField &u, int numInterior, int numReflecting, int numAbsorbing);
+    template <bool QUIESCENT>
+    void updateFluxImpl(SolutionField &u, int numReflecting, int numAbsorbing);
+    void levelFaceCounts(int maxLevel, int &numInterior, int &numReflecting, int &numAbsorbing);
+
     Config config;    // Configuration object
 
     int fc = 1;                               // Numerical flux coefficient
+    bool m_quiescent;                         // Zero mean flow: pure acoustic flux jacobians
+    double m_waveSpeed;                       // Largest wave speed: c0 + |v0|
     int m_Dim = 3;                            // Physical space dimension
     int m_elDim;                              // Dimension of the element (and the domain)
     std::vector<int> m_elType;                // Element Types (integer)
     std::string m_elName;                     // Element Type name
     int m_elOrder;                            // Element Order
     int m_elNumNodes;                         // Number of nodes per element
+    int m_elNumPrimaryNodes;                  // Number of primary nodes (vertices) per element
     int m_elNumIntPts;                        // Number of integration points
     int m_elNum;                              // Number of elements in dim
     std::string m_elIntType;                  // Integration type name
@@ -233,11 +381,18 @@ private:
     std::vector<size_t> m_elTags;             // Tags of the elements
     std::vector<size_t> m_elNodeTags;         // Tags of the nodes associated to each element
                                               // [e1n1, e1n2, ..., e2n1, e2n2, ...]
-    std::vector<double> m_elJacobians;        // Jacobian evaluated at each integration points : (dx/du)
+    std::vector<double> m_nodeCoords;         // x, y, z coordinates of the nodes associated to each element
+                                              // [e1n1x, e1n1y, e1n1z, e1n2x, ..., e2n1x, ...]
+    std::vector<double> m_elJacobians;        // Jacobian evaluated at each integration points : (dx/du), released after the preprocessing
                                               // [e1g1Jxx, e1g1Jxy, e1g1Jxz, ..., e1gGJzz, e2g1Jxx, ...]
-    std::vector<double> m_elJacobianDets;     // Determinants of the jacobian evaluated at each integration points
-                                              // [e1g1DetJ, e1g2DetJ, ... e2g1DetJ, e2g2DetJ, ...]
-    std::vector<double> m_elIntPtCoords;      // x, y, z coordinates of the integration points element by element.
+    std::vector<double> m_elInvJacobians;     // Inverse jacobian (du/dx) of the affine elements (constant over the element)
+                                              // [e1du/dx, e1du/dy, e1du/dz, e1dv/dx, ..., e1dw/dz, e2du/dx, ...]
+    std::vector<int> m_elCurvedIds;           // Index of each curved element in m_elGradBasisFcts, -1 if affine
+    std::vector<double> m_elJacobianDets;     // Determinant of the jacobian of the affine elements (constant over the element)
+                                              // [e1DetJ, e2DetJ, ...]
+    std::vector<double> m_elCurvedJacobianDets; // Determinants of the jacobian of the curved elements at each integration points
+                                                // [c1g1DetJ, c1g2DetJ, ... c2g1DetJ, c2g2DetJ, ...]
+    std::vector<double> m_elIntPtCoords;      // x, y, z coordinates of the integration points element by element, released after the preprocessing
                                               // [e1g1x, e1g1y, e1g1z, ... , e1gGz, e2g1x, ...]
     std::vector<double> m_elIntParamCoords;   // u, v, w coordinates and the weight q for each integration point
                                               // [g1u, g1v, g1w, g1q, g2u, ...]
@@ -245,9 +400,9 @@ private:
                                               // [g1f1, g1f2, ..., g2f1, g2f2, ...]
     std::vector<double> m_elUGradBasisFcts;   // Evaluation of the derivatives of the basis functions at the integration points
                                               // [g1df1/du, g1df1/dv, ..., g2df1/du, g2df1/dv, ..., g1df2/du, g1df2/dv, ...]
-    std::vector<double> m_elGradBasisFcts;    // Evaluation of the derivatives of the basis functions at the integration points
+    std::vector<double> m_elGradBasisFcts;    // Evaluation of the derivatives of the basis functions at the integration points (curved elements only)
                                               // [e1g1df1/dx, e1g1df1/dy, ..., e1g2df1/dx, e1g2df1/dy, ..., e1g1df2/dx, e1g1df2/dy, ...]
-    std::vector<size_t> m_elFIds;             // Faces ids for each element
+    std::vector<uint32_t> m_elFIds;           // Faces ids for each element
                                               // [e1f1, e1f2, ..., e2f1, e2f2, ...]
     std::vector<size_t> m_elFNodeTags;        // Node tags for each face and each element
     std::vector<size_t> m_elFNodeTagsOrdered; // Ordered used for comparison, UnOrdered preserve GMSH ordering and locality
@@ -255,6 +410,9 @@ private:
     std::vector<int> m_elFOrientation;        // Contains 1 or -1, if the outward element face is in the same direction
                                               // as the face normal or -1 if not. [e1f1, e1f2, ..., e2f1, e2f2]
     std::vector<double> m_elWeight;
+    std::vector<double> m_elInRadius;         // Inscribed radius estimate of each element
+    SpatialIndex m_spatialIndex;              // Grid over the element nodes and elements for point queries
+    std::vector<uint32_t> m_elNewIds;         // Id of each element in the order of the mesh file, empty if not reordered
 
     int m_fDim;                             // Face dimension
     std::string m_fName;                    // Face type name
@@ -290,112 +448,44 @@ private:
     std::vector<double> m_fBiTangents;         // BiTangent for each face at each int point
                                             // [f1g1Sx, f1g1Sy, f1g1Sz, f1g2Sx, ..., f2g1Sx, f2g1Sy, f2g1Sz, ...]                                        
 
-    std::vector<std::vector<size_t>> m_fNbrElIds;  // Id of element of each side of the face
-    std::vector<std::vector<size_t>> m_fNToElNIds; // Map face node Ids to element node Ids
-
-    std::vector<double> m_elMassMatrices; // Element mass matrix stored contiguously (row major)
+    std::vector<uint32_t> m_fNbrElIds;  // Id of element of each side of the face (side 1 unused for boundaries)
+                                        // [f1s0, f1s1, f2s0, f2s1, ...]
+    std::vector<uint32_t> m_fNToElNIds; // Map face node Ids to element node Ids on each side of the face
+                                        // [f1n1s0, f1n1s1, f1n2s0, ..., f2n1s0, ...]
+    std::vector<uint32_t> m_fInteriorIds; // Faces shared by two elements
+    std::vector<uint32_t> m_fBoundaryIds; // Faces with a single element, reflecting ones first then absorbing ones
+    int m_fNumReflecting = 0;             // Number of reflecting faces at the beginning of m_fBoundaryIds
+    std::vector<int> m_fInteriorLevelEnd;   // Local time stepping: number of interior faces of level <= l (see setTimeLevels)
+    std::vector<int> m_fReflectingLevelEnd; // Same for the reflecting faces
+    std::vector<int> m_fAbsorbingLevelEnd;  // Same for the absorbing faces
+
+    std::vector<double> m_refMassMatrix;  // Inverse mass matrix of the reference element (row major)
+                                          // [m11, m12, ..., m21, m22, ...]
+    std::vector<double> m_elRefDiffMatrices; // Reference weak differentiation matrices [D_u D_v D_w] (row major)
+                                             // [i1u j1, i1u j2, ..., i1v j1, ..., i2u j1, ...]
+    std::vector<double> m_fLiftMatrix;    // Reference face lift matrix w_g * phi_n(g) (row major)
+                                          // [n1g1, n1g2, ..., n2g1, n2g2, ...]
+    std::vector<double> m_elMassMatrices; // Inverse mass matrix of the curved elements stored contiguously (row major)
                                           // [e1m11, e1m12, ..., e1m21, e1m22, ..., e2m11, ...]
-    std::vector<double> m_fFlux;          // Flux through all faces
-                                          // [f1n1, f1n2, ..., f2n1, f2n2, ...]
+    std::vector<double> m_fluxJacobians;  // Flux jacobians A_x, A_y, A_z of the linearized Euler equations (row major)
+                                          // [Ax11, Ax12, ..., Ax44, Ay11, ..., Az44]
+    std::vector<double> m_fFlux;          // Flux through all faces at the integration points (times the surface jacobian)
+                                          // [f1eq0g1, f1eq0g2, ..., f1eq1g1, ..., f2eq0g1, ...]
 
     std::vector<bool> m_fIsBoundary; // Is Face a boundary
     std::vector<size_t> m_fBC;       // Boundary type
 
     std::vector<double> m_fWeight;
 
-    std::vector<std::vector<double>> RKR; // R*K*R^-1 matrix product, absorbing boundary
-
-    std::vector<std::vector<double>> uGhost;                 // Ghost element nodal solution
-    std::vector<std::vector<std::vector<double>>> FluxGhost; // Ghost flux
-};
-
-//! Tables operation functions
-
-template <typename T>
-bool isNCoincidentValues3d(std::vector<T> &vec1, std::vector<T> &vec2)
-{
-    return ((vec1[0] == vec2[0]) && (vec1[1] == vec2[1]) && (vec1[2] == vec2[2])) ||
-           ((vec1[0] == vec2[1]) && (vec1[1] == vec2[0]) && (vec1[2] == vec2[2])) ||
-           ((vec1[0] == vec2[2]) && (vec1[1] == vec2[1]) && (vec1[2] == vec2[0])) ||
-           ((vec1[0] == vec2[0]) && (vec1[1] == vec2[2]) && (vec1[2] == vec2[1])) ||
-           ((vec1[0] == vec2[2]) && (vec1[1] == vec2[0]) && (vec1[2] == vec2[1])) ||
-           ((vec1[0] == vec2[1]) && (vec1[1] == vec2[2]) && (vec1[2] == vec2[0]));
-}
-
-template <typename T>
-bool isNCoincidentValues2d(std::vector<T> &vec1, std::vector<T> &vec2)
-{
-    return ((vec1[0] == vec2[0]) && (vec1[1] == vec2[1])) ||
-           ((vec1[0] == vec2[1]) && (vec1[1] == vec2[0]));
-}
-
-template <typename T>
-bool isNCoincidentValues(std::vector<T> &vec1, std::vector<T> &vec2, size_t Num)
-{
-    // bool value(true);
-    // #pragma omp parallel for reduction(*:value)
-    //     for (size_t i=0; i<Num;i++)
-    //         value *= (vec1[i] == vec2[i]);
-
-    // value = std::equal(std::execution::seq, vec1.begin(), vec1.end(), vec2.begin());
-
-    return std::equal(std::execution::seq, vec1.begin(), vec1.end(), vec2.begin());
-}
-
-template <typename T>
-std::vector<std::vector<T>> vector_to_matrix(std::vector<T> &vec, size_t offset = 2)
-{
-    std::vector<std::vector<T>> mat;
-
-    for (size_t i = 0; i < vec.size(); i += offset)
-    {
-        std::vector<size_t> row;
-        for (size_t j = 0; j < offset; j++)
-        {
-            row.push_back(vec[i + j]);
-        }
-        mat.push_back(row);
-    }
-    return mat;
-}
+    std::vector<double> RKR; // R*K*R^-1 matrix product at the absorbing face integration points (row major)
+                             // [a1g1m11, a1g1m12, ..., a1g1m44, a1g2m11, ..., a2g1m11, ...]
 
-// template <typename T>
-std::vector<size_t> vector_of_tags(size_t vec_size, size_t offset);
-// {
-//     std::vector<size_t> value;
-//     for (size_t i = 0,id=0; i < vec_size; i++, id+=(i%offset))
-//     {
-//         std::cout<<id<<std::endl;
-//         value.push_back(id);
-//     }
-//     return value;
-// }
+    ElFluxKernel m_elFluxKernel;             // Surface term of an element (getElFlux)
+    ElMassKernel m_elMassKernel;             // Inverse mass matrix product (elMassUpdate)
+    simd::Isa m_simdIsa;                     // Instruction set of the affine element kernel
+    simd::AffineUpdateKernel m_affineUpdate; // Update of a batch of affine elements
 
-template <typename T>
-std::vector<T> matrix_to_vector(std::vector<std::vector<T>> &mat, size_t &offset)
-{
-    std::vector<T> vec;
-    offset = mat[0].size();
-    for (size_t i = 0; i < mat.size(); i++)
-    {
-        for (size_t j = 0; j < mat[i].size(); j++)
-        {
-            vec.push_back(mat[i][j]);
-        }
-    }
-    return vec;
-}
-
-template <typename T>
-void erase_row_from_matrix(std::vector<std::vector<T>> &mat, size_t &row_id)
-{
-    mat.erase(std::next(std::begin(mat), row_id));
-}
-
-template <typename T>
-void erase_row_from_vector(std::vector<T> &vec, size_t &id)
-{
-    vec.erase(std::next(std::begin(vec), id));
-}
+    SolutionField FluxGhost; // Ghost normal flux at the integration points of each boundary face (m_fBoundaryIds order)
+};
 
 #endif // DGALERKIN_MESH_H
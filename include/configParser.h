@@ -28,14 +28,14 @@ public:
 
     std::string formula = "";
     std::vector<double> source;
-    EQ_EDIT expression;
-    double value(double t)
+    mutable EQ_EDIT expression; // Parser state only
+    double value(double t) const
     {
         bool go = (formula != "");
         return expression.value(go, formula, {{"t", t}});
     }
 
-    double interpolate_value(double t)
+    double interpolate_value(double t) const
     {
         // linear interpolation using dechotomy method to find interpolation bounds in the data table
 
@@ -78,6 +78,14 @@ struct Config
     double timeStep = 0.1;
     double timeRate = 0.1;
 
+    // timeStep = auto: largest stable time step of the mesh and time scheme,
+    // times the safety factor, rounded down to divide timeRate
+    bool timeStepAuto = false;
+    double timeStepSafety = 0.8;
+
+    // Local time stepping (LTS-AB3): maximum number of time levels
+    int timeLevels = 8;
+
     // Element Type:
     std::string elementType = "Lagrange";
 
@@ -97,6 +105,24 @@ struct Config
     // Number of threads
     int numThreads = 1;
 
+    // Use and refresh the preprocessed mesh cache (<meshFileName>.dgcache)
+    bool meshCache = true;
+
+    // Renumber the elements along a Morton curve for memory locality
+    bool meshReordering = false;
+
+    // Number of elements per block of the batched (BLAS-3) time step, 0 = element by element
+    int elBlockSize = 0;
+
+    // Instruction set of the element kernels: auto, avx512, avx2 or scalar
+    std::string simd = "auto";
+
+    // Time the element kernels of each supported instruction set before solving
+    bool simdBenchmark = false;
+
+    // Time the face flux kernel from 1 to numThreads threads before solving
+    bool fluxBenchmark = false;
+
     // Sources
     // struct sources
     // {
@@ -0,0 +1,165 @@
+#ifndef DGALERKIN_MESHCACHE_H
+#define DGALERKIN_MESHCACHE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "configParser.h"
+
+/**
+ * Binary cache of the preprocessed mesh (basis functions, jacobians,
+ * face topology, normals, RKR matrices, inverse mass matrices, ...).
+ *
+ * The cache file is written next to the mesh file (<mesh>.dgcache) and is
+ * keyed by the cache format version, a hash of the mesh file content and a
+ * hash of the configuration parameters entering the preprocessing. Repeated
+ * runs on the same mesh (e.g. parameter sweeps) map the file at startup and
+ * skip Gmsh and all the precomputations. Any mismatch silently falls back
+ * to the full preprocessing, which then refreshes the cache.
+ */
+namespace meshCache
+{
+    // Bump when the content or the layout of the cached Mesh state changes.
+    const uint32_t version = 9;
+
+    /**
+     * Name of the cache file associated with a mesh file.
+     */
+    std::string fileName(std::string meshFileName);
+
+    /**
+     * 64 bits FNV-1a hash of the content of a file (0 if it cannot be read).
+     */
+    uint64_t hashFile(std::string fileName);
+
+    /**
+     * Hash of the configuration parameters the preprocessed mesh depends on.
+     */
+    uint64_t hashConfig(Config const &config);
+
+    /**
+     * Retrieve the (tag, name) of the boundary physical groups of the mesh.
+     * They are read from the cache file when it matches the mesh file,
+     * otherwise the mesh is opened (see meshModel::open) and queried.
+     *
+     * @param meshFileName Mesh file (.msh)
+     * @param useCache Whether the cache file may be used
+     * @param numThreads Number of threads used to read the mesh
+     * @param physGroups Output (tag, name) of each boundary physical group
+     */
+    void getPhysicalGroups(std::string meshFileName, bool useCache, int numThreads,
+                           std::vector<std::pair<int, std::string>> &physGroups);
+
+    class Reader;
+
+    /**
+     * Check the cache header against the mesh file hash and read
+     * the physical groups stored right after it.
+     *
+     * @return true if the cache matches the mesh file content
+     */
+    bool readHeader(Reader &reader, uint64_t meshHash, uint64_t &configHash,
+                    std::vector<std::pair<int, std::string>> &physGroups);
+
+    /**
+     * Sequential binary writer. Every record is padded to 8 bytes so that
+     * the arrays are aligned once the file is mapped in memory.
+     */
+    class Writer
+    {
+    public:
+        Writer(std::string fileName);
+        ~Writer();
+
+        bool good() { return m_file != nullptr && !m_error; }
+        void writeRaw(const void *data, size_t size);
+
+        template <typename T>
+        void write(T const &value) { writeRaw(&value, sizeof(T)); }
+        template <typename T>
+        void write(std::vector<T> const &v)
+        {
+            write((uint64_t)v.size());
+            writeRaw(v.data(), v.size() * sizeof(T));
+        }
+        template <typename T>
+        void write(std::vector<std::vector<T>> const &v)
+        {
+            write((uint64_t)v.size());
+            for (size_t i = 0; i < v.size(); ++i)
+                write(v[i]);
+        }
+        void write(std::vector<bool> const &v);
+        void write(std::string const &s);
+
+        template <typename T>
+        void io(T &value) { write(value); }
+
+    private:
+        FILE *m_file = nullptr;
+        bool m_error = false;
+    };
+
+    /**
+     * Sequential binary reader over a memory mapped file. All reads are
+     * bounds checked: a truncated or corrupted file makes good() false.
+     */
+    class Reader
+    {
+    public:
+        Reader(std::string fileName);
+        ~Reader();
+
+        bool good() { return m_data != nullptr && !m_error; }
+        const char *readRaw(size_t size);
+
+        template <typename T>
+        void read(T &value)
+        {
+            const char *p = readRaw(sizeof(T));
+            if (p)
+                value = *reinterpret_cast<const T *>(p);
+        }
+        template <typename T>
+        void read(std::vector<T> &v)
+        {
+            uint64_t n = 0;
+            read(n);
+            const char *p = (n <= m_size) ? readRaw(n * sizeof(T)) : nullptr;
+            if (p)
+                v.assign(reinterpret_cast<const T *>(p), reinterpret_cast<const T *>(p) + n);
+            else
+                m_error = true;
+        }
+        template <typename T>
+        void read(std::vector<std::vector<T>> &v)
+        {
+            uint64_t n = 0;
+            read(n);
+            if (n > m_size)
+            {
+                m_error = true;
+                return;
+            }
+            v.resize(n);
+            for (size_t i = 0; i < n && !m_error; ++i)
+                read(v[i]);
+        }
+        void read(std::vector<bool> &v);
+        void read(std::string &s);
+
+        template <typename T>
+        void io(T &value) { read(value); }
+
+    private:
+        const char *m_data = nullptr;
+        size_t m_size = 0;
+        size_t m_pos = 0;
+        bool m_error = false;
+    };
+}
+
+#endif // DGALERKIN_MESHCACHE_H
@@ -0,0 +1,110 @@
+#ifndef DGALERKIN_MESHMODEL_H
+#define DGALERKIN_MESHMODEL_H
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Subset of the Gmsh model API used to preprocess the mesh. The signatures
+ * and the data layouts follow gmsh::model and gmsh::model::mesh, so that
+ * the Mesh class is independent of where the data comes from:
+ *  - MshModel reads MSH 4.1 files natively (see mshReader.h),
+ *  - GmshModel forwards to the Gmsh SDK for all the other files, when the
+ *    solver is built with WITH_GMSH (DGALERKIN_WITH_GMSH).
+ */
+class MeshModel
+{
+public:
+    virtual ~MeshModel() {}
+
+    virtual int getDimension() = 0;
+
+    /**
+     * (tag, name) of the physical groups of dimension dim.
+     */
+    virtual void getPhysicalGroups(std::vector<std::pair<int, std::string>> &physGroups, int dim) = 0;
+    virtual void getNodesForPhysicalGroup(int dim, int tag, std::vector<size_t> &nodeTags) = 0;
+    virtual void getNodes(std::vector<size_t> &nodeTags, std::vector<double> &coord) = 0;
+
+    virtual void getElementTypes(std::vector<int> &elementTypes, int dim) = 0;
+    virtual int getElementType(std::string familyName, int order) = 0;
+    virtual void getElementProperties(int elementType, std::string &elementName, int &dim, int &order, int &numNodes,
+                                      std::vector<double> &localNodeCoord, int &numPrimaryNodes) = 0;
+    virtual void getElementsByType(int elementType, std::vector<size_t> &elementTags, std::vector<size_t> &nodeTags) = 0;
+    virtual void getElementEdgeNodes(int elementType, std::vector<size_t> &nodeTags) = 0;
+    virtual void getElementFaceNodes(int elementType, int faceType, std::vector<size_t> &nodeTags) = 0;
+    virtual void getBarycenters(int elementType, std::vector<double> &barycenters) = 0;
+
+    virtual void getIntegrationPoints(int elementType, std::string integrationType,
+                                      std::vector<double> &localCoord, std::vector<double> &weights) = 0;
+    virtual void getBasisFunctions(int elementType, std::vector<double> const &localCoord, std::string functionSpaceType,
+                                   std::vector<double> &basisFunctions) = 0;
+    virtual void getJacobians(int elementType, std::vector<double> const &localCoord, std::vector<double> &jacobians,
+                              std::vector<double> &determinants, std::vector<double> &coord, int tag = -1) = 0;
+
+    /**
+     * Add a new discrete entity of dimension dim containing the given
+     * elements (element tags are generated).
+     *
+     * @return Tag of the new entity
+     */
+    virtual int addElements(int dim, int elementType, std::vector<size_t> const &nodeTags) = 0;
+};
+
+#ifdef DGALERKIN_WITH_GMSH
+/**
+ * Gmsh SDK backed model (the mesh must be opened with gmsh::open).
+ */
+class GmshModel : public MeshModel
+{
+public:
+    int getDimension() override;
+    void getPhysicalGroups(std::vector<std::pair<int, std::string>> &physGroups, int dim) override;
+    void getNodesForPhysicalGroup(int dim, int tag, std::vector<size_t> &nodeTags) override;
+    void getNodes(std::vector<size_t> &nodeTags, std::vector<double> &coord) override;
+    void getElementTypes(std::vector<int> &elementTypes, int dim) override;
+    int getElementType(std::string familyName, int order) override;
+    void getElementProperties(int elementType, std::string &elementName, int &dim, int &order, int &numNodes,
+                              std::vector<double> &localNodeCoord, int &numPrimaryNodes) override;
+    void getElementsByType(int elementType, std::vector<size_t> &elementTags, std::vector<size_t> &nodeTags) override;
+    void getElementEdgeNodes(int elementType, std::vector<size_t> &nodeTags) override;
+    void getElementFaceNodes(int elementType, int faceType, std::vector<size_t> &nodeTags) override;
+    void getBarycenters(int elementType, std::vector<double> &barycenters) override;
+    void getIntegrationPoints(int elementType, std::string integrationType,
+                              std::vector<double> &localCoord, std::vector<double> &weights) override;
+    void getBasisFunctions(int elementType, std::vector<double> const &localCoord, std::string functionSpaceType,
+                           std::vector<double> &basisFunctions) override;
+    void getJacobians(int elementType, std::vector<double> const &localCoord, std::vector<double> &jacobians,
+                      std::vector<double> &determinants, std::vector<double> &coord, int tag = -1) override;
+    int addElements(int dim, int elementType, std::vector<size_t> const &nodeTags) override;
+};
+#endif // DGALERKIN_WITH_GMSH
+
+/**
+ * Current model, in the manner of the Gmsh singleton.
+ */
+namespace meshModel
+{
+    /**
+     * Open a mesh file: MSH 4.1 files made of supported elements are read
+     * natively, the other files are opened with the Gmsh SDK, which is only
+     * initialized then. Without WITH_GMSH, they are a fatal error.
+     *
+     * @param fileName Mesh file
+     * @param numThreads Number of threads used by the native reader
+     */
+    void open(std::string fileName, int numThreads);
+
+    bool isOpen();
+
+    /**
+     * Release the current model, and the Gmsh SDK if it was initialized.
+     */
+    void close();
+
+    MeshModel &current();
+}
+
+#endif // DGALERKIN_MESHMODEL_H
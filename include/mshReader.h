@@ -0,0 +1,88 @@
+#ifndef DGALERKIN_MSHREADER_H
+#define DGALERKIN_MSHREADER_H
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "meshModel.h"
+
+/**
+ * Native reader of Gmsh MSH 4.1 files (ASCII and binary). Nodes, elements
+ * and physical groups are read directly in flat arrays. The large node and
+ * element blocks are parsed in parallel: in ASCII the line boundaries are
+ * located first, then the lines are converted by chunks.
+ *
+ * The reference element tables (basis functions, quadrature, jacobians)
+ * are provided by referenceElement.h, so the Gmsh SDK is not used at all
+ * for these meshes.
+ */
+class MshModel : public MeshModel
+{
+public:
+    /**
+     * Read a mesh file.
+     *
+     * @param fileName Mesh file (.msh)
+     * @param numThreads Number of threads used to parse the node and element blocks
+     * @return false if the file is not a MSH 4.1 file made of supported elements
+     */
+    bool read(std::string fileName, int numThreads);
+
+    int getDimension() override;
+    void getPhysicalGroups(std::vector<std::pair<int, std::string>> &physGroups, int dim) override;
+    void getNodesForPhysicalGroup(int dim, int tag, std::vector<size_t> &nodeTags) override;
+    void getNodes(std::vector<size_t> &nodeTags, std::vector<double> &coord) override;
+    void getElementTypes(std::vector<int> &elementTypes, int dim) override;
+    int getElementType(std::string familyName, int order) override;
+    void getElementProperties(int elementType, std::string &elementName, int &dim, int &order, int &numNodes,
+                              std::vector<double> &localNodeCoord, int &numPrimaryNodes) override;
+    void getElementsByType(int elementType, std::vector<size_t> &elementTags, std::vector<size_t> &nodeTags) override;
+    void getElementEdgeNodes(int elementType, std::vector<size_t> &nodeTags) override;
+    void getElementFaceNodes(int elementType, int faceType, std::vector<size_t> &nodeTags) override;
+    void getBarycenters(int elementType, std::vector<double> &barycenters) override;
+    void getIntegrationPoints(int elementType, std::string integrationType,
+                              std::vector<double> &localCoord, std::vector<double> &weights) override;
+    void getBasisFunctions(int elementType, std::vector<double> const &localCoord, std::string functionSpaceType,
+                           std::vector<double> &basisFunctions) override;
+    void getJacobians(int elementType, std::vector<double> const &localCoord, std::vector<double> &jacobians,
+                      std::vector<double> &determinants, std::vector<double> &coord, int tag = -1) override;
+    int addElements(int dim, int elementType, std::vector<size_t> const &nodeTags) override;
+
+private:
+    /**
+     * Elements of a given type classified on a given entity.
+     */
+    struct Block
+    {
+        int dim;
+        int entity;
+        int type;
+        std::vector<size_t> elTags;   // [e1, e2, ...]
+        std::vector<size_t> nodeTags; // [e1n1, e1n2, ..., e2n1, ...]
+    };
+
+    class Parser;
+    bool readEntities(Parser &parser);
+    bool readNodes(Parser &parser);
+    bool readElements(Parser &parser);
+
+    /**
+     * Blocks of a given type sorted by entity tag (Gmsh ordering).
+     */
+    std::vector<Block const *> getBlocks(int elementType, int tag = -1);
+    const double *nodeCoord(size_t nodeTag) { return &m_nodeCoords[m_nodeIds[nodeTag] * 3]; }
+
+    int m_numThreads = 1;
+    int m_dim = -1;
+    size_t m_maxElTag = 0;
+    std::vector<size_t> m_nodeTags;   // [n1, n2, ...]
+    std::vector<double> m_nodeCoords; // [n1x, n1y, n1z, n2x, ...]
+    std::vector<size_t> m_nodeIds;    // Node tag to index in m_nodeTags
+    std::vector<Block> m_blocks;
+    std::map<std::pair<int, int>, std::string> m_physNames;           // (dim, tag) -> name
+    std::map<std::pair<int, int>, std::vector<int>> m_entityPhysTags; // (dim, entity) -> physical tags
+};
+
+#endif // DGALERKIN_MSHREADER_H
@@ -0,0 +1,63 @@
+#ifndef DGALERKIN_REFERENCEELEMENT_H
+#define DGALERKIN_REFERENCEELEMENT_H
+
+#include <string>
+#include <vector>
+
+/**
+ * Reference Lagrange simplices (points, lines, triangles and tetrahedra of
+ * order 1 and 2) following the Gmsh conventions: element type numbers, node
+ * numbering, parametric coordinates (u in [-1, 1] for lines, unit simplex
+ * otherwise) and ordering of the element edges and faces.
+ *
+ * They provide the basis functions and quadrature tables when the mesh is
+ * read natively (see mshReader.h), i.e. without the Gmsh SDK.
+ */
+namespace referenceElement
+{
+    /**
+     * Whether the Gmsh element type is supported (1, 2, 4, 8, 9, 11, 15).
+     */
+    bool isSupported(int elementType);
+
+    /**
+     * Gmsh element type of a family ("point", "line", "triangle",
+     * "tetrahedron") for a given order, -1 if not supported.
+     */
+    int getType(std::string familyName, int order);
+
+    /**
+     * Same outputs as gmsh::model::mesh::getElementProperties.
+     */
+    void getProperties(int elementType, std::string &name, int &dim, int &order, int &numNodes,
+                       std::vector<double> &localNodeCoord, int &numPrimaryNodes);
+
+    /**
+     * Quadrature rule exact for polynomials of the given degree.
+     *
+     * @param localCoord Output u, v, w coordinates of the points [g1u, g1v, g1w, g2u, ...]
+     * @param weights Output weights [g1q, g2q, ...]
+     */
+    void getIntegrationPoints(int elementType, int degree, std::vector<double> &localCoord,
+                              std::vector<double> &weights);
+
+    /**
+     * Evaluate the basis functions (or their parametric derivatives)
+     * with the same layout as gmsh::model::mesh::getBasisFunctions.
+     *
+     * @param localCoord u, v, w coordinates of the evaluation points
+     * @param grad Derivatives along u, v, w instead of values
+     * @param basisFunctions Output [g1f1, g1f2, ...] or [g1df1/du, g1df1/dv, g1df1/dw, g1df2/du, ...]
+     */
+    void getBasisFunctions(int elementType, std::vector<double> const &localCoord, bool grad,
+                           std::vector<double> &basisFunctions);
+
+    /**
+     * Local nodes of each edge (lines and triangles) or of each face
+     * (tetrahedra) of an element, high order nodes included.
+     */
+    std::vector<std::vector<int>> const &getEdges(int elementType);
+    std::vector<std::vector<int>> const &getFaces(int elementType);
+}
+
+#endif // DGALERKIN_REFERENCEELEMENT_H
@@ -0,0 +1,90 @@
+#ifndef DGALERKIN_SIMDKERNELS_H
+#define DGALERKIN_SIMDKERNELS_H
+
+#include <string>
+
+/**
+ * Vectorized element kernels.
+ *
+ * The update of the affine elements is processed by batches of W consecutive
+ * elements, one element per SIMD lane: the batch is transposed to an
+ * array-of-structures-of-arrays layout [variable][node][lane] and every
+ * operation of the kernel (flux jacobians, contravariant flux, reference
+ * differentiation and inverse mass matrices) is applied to the W elements
+ * at once. The kernel is compiled for each instruction set and the best one
+ * supported by the CPU is selected at runtime; the scalar kernel (W = 1) is
+ * the portable fallback. Each kernel is also instantiated for the common
+ * element sizes, with compile time loop trip counts.
+ */
+namespace simd
+{
+    enum class Isa
+    {
+        Scalar,
+        AVX2,  // 4 doubles per instruction
+        AVX512 // 8 doubles per instruction
+    };
+
+    // Largest number of elements per batch
+    const int maxWidth = 8;
+
+    /**
+     * Batch of affine elements: the reference operators are shared, the
+     * geometry and the state are given for each element of the batch.
+     */
+    struct AffineBatch
+    {
+        int numNodes;         // Nodes per element
+        int dim;              // Element dimension
+        const double *D;      // Reference differentiation matrices [D_u D_v D_w] (numNodes x dim*numNodes, row major)
+        const double *M;      // Reference inverse mass matrix (numNodes x numNodes, row major)
+        const double *A;      // Flux jacobians A_x, A_y, A_z (3 x 4 x 4, row major)
+        const double *invJ;   // Inverse jacobian of each element (9 per element, du_u/dx_x row major)
+        double det[maxWidth]; // Jacobian determinant of each element
+        const double *elFlux; // Surface term of each element [e1eq0n1, ..., e1eq1n1, ..., e2eq0n1, ...]
+        double *u[4];         // Solution of the first node of the batch, for each variable
+        double *y[4];         // Output of the first node of the batch (may be u), for each variable
+        double dt;            // Time step
+        double beta;          // y = beta*y + dt*M^-1*(S[u] - F)
+    };
+
+    typedef void (*AffineUpdateKernel)(const AffineBatch &batch);
+
+    /**
+     * Best instruction set supported by the CPU.
+     */
+    Isa detect();
+
+    bool isSupported(Isa isa);
+
+    /**
+     * Instruction set from its name ("auto", "scalar", "avx2", "avx512").
+     * Unsupported instruction sets fall back to the best supported one.
+     */
+    Isa select(std::string name);
+
+    std::string name(Isa isa);
+
+    /**
+     * Number of elements processed at once by the kernels of an instruction set.
+     */
+    int width(Isa isa);
+
+    /**
+     * Update kernel of width(isa) affine elements:
+     * y = beta*y + dt/detJ * M^-1 * (S[u] - F) for the four equations.
+     * The quiescent kernel assumes a zero mean flow (sparse flux jacobians).
+     */
+    AffineUpdateKernel affineUpdate(Isa isa, bool quiescent = false);
+
+    /**
+     * Same update kernel, specialized at compile time on the number of nodes
+     * and the dimension of the element when an instantiation exists
+     * (triangles and tetrahedra of order 1 to 4), generic otherwise.
+     */
+    AffineUpdateKernel affineUpdate(Isa isa, int dim, int numNodes, bool quiescent = false);
+
+    bool isSpecialized(int dim, int numNodes);
+}
+
+#endif // DGALERKIN_SIMDKERNELS_H
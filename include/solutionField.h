@@ -0,0 +1,86 @@
+#ifndef DGALERKIN_SOLUTIONFIELD_H
+#define DGALERKIN_SOLUTIONFIELD_H
+
+#include <cstddef>
+
+/**
+ * Nodal (or integration point) field of several variables, e.g. the solution
+ * (p, vx, vy, vz) of the linearized Euler equations.
+ *
+ * All the variables live in a single 64-byte aligned allocation, one after
+ * the other (structure of arrays). Each variable is padded to a multiple of
+ * 64 bytes, so that every variable view starts on a cache line / SIMD
+ * register boundary. Inside a variable the points are stored element by
+ * element: [e1n1, e1n2, ..., e2n1, e2n2, ...], as the DOFs of the mesh.
+ *
+ * The memory is first touched by the OpenMP threads with the same static
+ * schedule as the element sweeps, so that on NUMA systems each page is
+ * placed close to the thread working on it.
+ */
+class SolutionField
+{
+public:
+    SolutionField() {}
+
+    /**
+     * @param numVars Number of variables
+     * @param numEl Number of elements (or faces)
+     * @param elNumPts Number of points per element (or face)
+     * @param numThreads Number of threads used for the first touch
+     */
+    SolutionField(int numVars, size_t numEl, int elNumPts, int numThreads = 1);
+    SolutionField(const SolutionField &other);
+    SolutionField(SolutionField &&other) noexcept;
+    SolutionField &operator=(const SolutionField &other);
+    SolutionField &operator=(SolutionField &&other) noexcept;
+    ~SolutionField();
+
+    /**
+     * Variable view: field[var][el * elNumPts + n]
+     */
+    inline double *operator[](int var)
+    {
+        return m_data + var * m_stride;
+    }
+    inline const double *operator[](int var) const
+    {
+        return m_data + var * m_stride;
+    }
+
+    /**
+     * Element view: values of a variable at the points of an element
+     */
+    inline double *el(int var, size_t el)
+    {
+        return m_data + var * m_stride + el * m_elNumPts;
+    }
+    inline const double *el(int var, size_t el) const
+    {
+        return m_data + var * m_stride + el * m_elNumPts;
+    }
+
+    void fill(double value);
+
+    int numVars() const { return m_numVars; }
+    size_t numEl() const { return m_numEl; }
+    int elNumPts() const { return m_elNumPts; }
+    size_t size() const { return m_numEl * m_elNumPts; } // Number of points per variable
+    size_t stride() const { return m_stride; }           // Distance between two variables
+    double *data() { return m_data; }
+    const double *data() const { return m_data; }
+
+    static constexpr size_t alignment = 64; // bytes
+
+private:
+    void allocate(int numVars, size_t numEl, int elNumPts, int numThreads);
+    void release();
+
+    double *m_data = nullptr;
+    int m_numVars = 0;
+    size_t m_numEl = 0;
+    int m_elNumPts = 0;
+    size_t m_stride = 0;
+    int m_numThreads = 1;
+};
+
+#endif // DGALERKIN_SOLUTIONFIELD_H
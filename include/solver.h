@@ -13,7 +13,7 @@ namespace solver
      * @param mesh
      * @param config
      */
-    void forwardEuler(std::vector<std::vector<double>> &u, Mesh &mesh, Config config);
+    void forwardEuler(SolutionField &u, Mesh &mesh, const Config &config);
 
     /**
      * Solve using explicit Runge-Kutta integration method. O(h^4)
@@ -22,7 +22,70 @@ namespace solver
      * @param mesh
      * @param config
      */
-    void rungeKutta(std::vector<std::vector<double>> &u, Mesh &mesh, Config config);
+    void rungeKutta(SolutionField &u, Mesh &mesh, const Config &config);
+
+    /**
+     * Solve using a low-storage (2N) explicit Runge-Kutta scheme:
+     * "LSRK54" (Carpenter-Kennedy) or "LSRK144" (Niegemann-Diehl-Busch). O(h^4)
+     *
+     * @param u initial nodal solution vector
+     * @param mesh
+     * @param config
+     */
+    void lowStorageRungeKutta(SolutionField &u, Mesh &mesh, const Config &config);
+
+    bool isLowStorageRK(const std::string &name);
+
+    /**
+     * Solve using multirate Adams-Bashforth local time stepping ("LTS-AB3"):
+     * the elements are clustered into power-of-two time levels, each level
+     * advancing with its own time step, config.timeStep being the one of the
+     * coarsest level. O(h^3)
+     *
+     * @param u initial nodal solution vector
+     * @param mesh
+     * @param config
+     */
+    void localTimeStepping(SolutionField &u, Mesh &mesh, const Config &config);
+
+    bool isLocalTimeStepping(const std::string &name);
+
+    /**
+     * Largest stable time step of a time integration method on the mesh,
+     * from the inscribed radius of the elements, the element order and the
+     * largest wave speed c0 + |v0|.
+     *
+     * @param mesh
+     * @param method time integration method
+     */
+    double stableTimeStep(Mesh &mesh, const std::string &method);
+
+    /**
+     * Time step of timeStep = auto: stable time step times the safety
+     * factor, rounded down to divide timeRate.
+     *
+     * @param mesh
+     * @param config
+     */
+    double autoTimeStep(Mesh &mesh, const Config &config);
+
+    /**
+     * Time the element kernels of each supported instruction set.
+     *
+     * @param u initial nodal solution vector
+     * @param mesh
+     * @param config
+     */
+    void benchmarkKernels(SolutionField &u, Mesh &mesh, const Config &config);
+
+    /**
+     * Time the face flux kernel from 1 to numThreads threads.
+     *
+     * @param u initial nodal solution vector
+     * @param mesh
+     * @param config
+     */
+    void benchmarkFaceFlux(SolutionField &u, Mesh &mesh, const Config &config);
 
     // std::vector<std::vector<float>> data4wave;
 
@@ -0,0 +1,73 @@
+#ifndef DGALERKIN_SPATIALINDEX_H
+#define DGALERKIN_SPATIALINDEX_H
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * Uniform grid built over the mesh bounding box. Each cell stores the element
+ * nodes (DOFs) it contains and the elements whose bounding box overlaps it.
+ * Point queries therefore only visit the few cells around the query point
+ * instead of scanning all the nodes of the mesh.
+ *
+ * The cell size is set from the mean element size, so that a cell holds
+ * a bounded number of nodes and elements whatever the mesh size.
+ */
+class SpatialIndex
+{
+public:
+    SpatialIndex() {}
+
+    /**
+     * Build the grid.
+     *
+     * @param nodeCoords x, y, z coordinates of the element nodes [e1n1x, e1n1y, e1n1z, e1n2x, ...]
+     * @param elNumNodes Number of nodes per element
+     * @param elNumVertices Number of primary nodes (vertices) per element
+     * @param dim Element dimension
+     */
+    void build(std::vector<double> const &nodeCoords, int elNumNodes, int elNumVertices, int dim);
+
+    /**
+     * Find all the nodes strictly inside a sphere. A negative or non finite
+     * radius, or a non finite center, selects no node.
+     *
+     * @param x Center of the sphere (x, y, z)
+     * @param radius Radius of the sphere
+     * @param nodeIds Output node ids (el * elNumNodes + n), sorted in ascending order
+     */
+    void radiusSearch(const double *x, double radius, std::vector<size_t> &nodeIds) const;
+
+    /**
+     * Find the element containing a point. Elements are assumed straight
+     * sided, i.e. the test only relies on the element vertices.
+     *
+     * @param x Point coordinates (x, y, z)
+     * @return Element id, or -1 if the point lies outside the mesh (or is not finite)
+     */
+    long locateElement(const double *x) const;
+
+private:
+    bool getCellRange(const double *lo, const double *hi, int *cellLo, int *cellHi) const;
+    size_t cellId(int i, int j, int k) const
+    {
+        return ((size_t)k * m_numCells[1] + j) * m_numCells[0] + i;
+    }
+    bool isInElement(size_t el, const double *x) const;
+
+    int m_dim = 3;
+    int m_elNumVertices = 0;
+    double m_lo[3] = {0, 0, 0};        // Lower corner of the grid
+    double m_cellSize[3] = {1, 1, 1};  // Cell size along x, y, z
+    int m_numCells[3] = {1, 1, 1};     // Number of cells along x, y, z
+
+    std::vector<size_t> m_nodeCellStart; // CSR offsets of the nodes per cell
+    std::vector<size_t> m_nodeIds;       // Node ids sorted by cell
+    std::vector<double> m_nodeCoords;    // Node coordinates sorted by cell [c1n1x, c1n1y, c1n1z, c1n2x, ...]
+
+    std::vector<size_t> m_elCellStart;    // CSR offsets of the elements per cell
+    std::vector<size_t> m_elIds;          // Element ids sorted by cell
+    std::vector<double> m_elVertexCoords; // Vertex coordinates of each element [e1v1x, e1v1y, e1v1z, e1v2x, ...]
+};
+
+#endif // DGALERKIN_SPATIALINDEX_H
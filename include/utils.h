@@ -118,6 +118,8 @@ namespace lapack
 
     void linEq(double *A, double *X, double *Y, double &alpha, double beta, int &N);
 
+    void gemm(double *A, double *B, double *C, double alpha, double beta, int M, int N, int K);
+
     void minus(double *A, double *B, int N);
 
     void plus(double *A, double *B, int N);
@@ -138,6 +140,8 @@ namespace eigen
 
     void linEq(double *A, double *X, double *Y, double &alpha, double beta, int &N);
 
+    void gemm(double *A, double *B, double *C, double alpha, double beta, int M, int N, int K);
+
     void minus(double *A, double *B, int N);
 
     void plus(double *A, double *B, int N);
@@ -1,23 +1,94 @@
 #include <algorithm>
 #include <assert.h>
 #include <chrono>
-#include <gmsh.h>
+#include <cmath>
 #include <iostream>
+#include <limits>
+#include <numeric>
 #include <omp.h>
+#include <parallel/algorithm>
 #include <string>
 
 #include "Mesh.h"
 #include "configParser.h"
+#include "meshCache.h"
+#include "meshModel.h"
 #include "utils.h"
 
 /**
- * Mesh constructor: load the mesh data and parameters thanks to
- * Gmsh api. Create the elements mapping and set the boundary conditions.
+ * Permute an element-indexed array (any fixed number of entries per element).
+ *
+ * @param v Array to permute
+ * @param perm Old element id of each new element id
+ */
+template <typename T>
+static void permuteElements(std::vector<T> &v, std::vector<uint32_t> const &perm, int numThreads)
+{
+    if (perm.empty())
+        return;
+    size_t stride = v.size() / perm.size();
+    std::vector<T> permuted(v.size());
+#pragma omp parallel for schedule(static) num_threads(numThreads)
+    for (size_t el = 0; el < perm.size(); ++el)
+        std::copy(v.begin() + perm[el] * stride, v.begin() + (perm[el] + 1) * stride, permuted.begin() + el * stride);
+    v.swap(permuted);
+}
+
+/**
+ * Mesh constructor: load the preprocessed mesh from the mesh cache when it
+ * matches the mesh file and the configuration, build it otherwise.
  *
  * @name string File name
  * @config config Configuration object (content of the config parsed and load in memory)
  */
-Mesh::Mesh(Config config) : config(config)
+Mesh::Mesh(const Config &config) : config(config)
+{
+    m_quiescent = (config.v0[0] == 0 && config.v0[1] == 0 && config.v0[2] == 0);
+    std::string cacheFileName = meshCache::fileName(config.meshFileName);
+    auto start = std::chrono::system_clock::now();
+    if (config.meshCache && loadCache(cacheFileName))
+    {
+        screen_display::write_string("Mesh loaded from cache " + cacheFileName, GREEN);
+    }
+    else
+    {
+        // The config parser only reads the physical groups from a cache
+        // matching the mesh file: the mesh may not be opened yet.
+        if (!meshModel::isOpen())
+            meshModel::open(config.meshFileName, config.numThreads);
+
+        build();
+        precomputeMassMatrix();
+        precomputeDiffMatrices();
+        precomputeLiftMatrix();
+
+        if (config.meshCache)
+        {
+            screen_display::write_string("Write mesh cache " + cacheFileName, GREEN);
+            saveCache(cacheFileName);
+        }
+    }
+
+    /**
+     * Extra Memory allocation:
+     * Instantiate Ghost Elements and numerical flux storage.
+     */
+    m_fFlux.resize(m_fNum * 4 * m_fNumIntPts);
+    precomputeFluxJacobians();
+    selectKernels();
+    precomputeInRadii();
+    FluxGhost = SolutionField(4, m_fBoundaryIds.size(), m_fNumIntPts, config.numThreads);
+
+    auto end = std::chrono::system_clock::now();
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
+    screen_display::write_value("Mesh total elapsed time:", elapsed.count() * 1.0e-6, "s", BLUE);
+}
+
+/**
+ * Load the mesh data and parameters thanks to Gmsh api.
+ * Create the elements mapping and set the boundary conditions.
+ */
+void Mesh::build()
 {
 
     /******************************
@@ -36,20 +107,59 @@ Mesh::Mesh(Config config) : config(config)
         std::cout << "\n";
     };
 
-    auto start = std::chrono::system_clock::now();
-    m_elDim = gmsh::model::getDimension();
-    gmsh::model::mesh::getElementTypes(m_elType, m_elDim);
-    int _numPrimaryNodes = 0;
+    MeshModel &model = meshModel::current();
 
-    gmsh::model::mesh::getElementProperties(m_elType[0], m_elName, m_elDim,
-                                            m_elOrder, m_elNumNodes, m_elParamCoord, _numPrimaryNodes);
+    auto start = std::chrono::system_clock::now();
+    m_elDim = model.getDimension();
+    model.getElementTypes(m_elType, m_elDim);
+    model.getElementProperties(m_elType[0], m_elName, m_elDim,
+                               m_elOrder, m_elNumNodes, m_elParamCoord, m_elNumPrimaryNodes);
 
-    gmsh::model::mesh::getElementsByType(m_elType[0], m_elTags, m_elNodeTags);
+    model.getElementsByType(m_elType[0], m_elTags, m_elNodeTags);
     m_elNum = (int)m_elTags.size();
+
+    /**
+     * Node coordinates are retrieved once with a single bulk call and
+     * stored per element node, following the m_elNodeTags ordering.
+     */
+    std::vector<size_t> _nodeTags;
+    std::vector<double> _nodeCoords;
+    model.getNodes(_nodeTags, _nodeCoords);
+    std::vector<size_t> _nodeIds(*std::max_element(_nodeTags.begin(), _nodeTags.end()) + 1);
+    for (size_t i = 0; i < _nodeTags.size(); ++i)
+        _nodeIds[_nodeTags[i]] = i;
+
+    m_nodeCoords.resize(m_elNodeTags.size() * 3);
+#pragma omp parallel for schedule(static) num_threads(config.numThreads)
+    for (size_t n = 0; n < m_elNodeTags.size(); ++n)
+        std::copy(&_nodeCoords[_nodeIds[m_elNodeTags[n]] * 3], &_nodeCoords[_nodeIds[m_elNodeTags[n]] * 3] + 3, &m_nodeCoords[n * 3]);
+
+    /**
+     * Optional renumbering of the elements along a Morton curve. The faces
+     * are numbered by first occurrence in the element order, so they
+     * follow. All the element-indexed arrays retrieved from the model are
+     * permuted right after retrieval.
+     */
+    std::vector<uint32_t> elPerm;
+    if (config.meshReordering)
+    {
+        elPerm = mortonOrder();
+        permuteElements(m_elTags, elPerm, config.numThreads);
+        permuteElements(m_elNodeTags, elPerm, config.numThreads);
+        permuteElements(m_nodeCoords, elPerm, config.numThreads);
+        m_elNewIds.resize(m_elNum);
+        for (size_t el = 0; el < m_elNum; ++el)
+            m_elNewIds[elPerm[el]] = el;
+    }
+
+    /**
+     * Spatial index used to locate sources, observers and initial conditions.
+     */
+    m_spatialIndex.build(m_nodeCoords, m_elNumNodes, m_elNumPrimaryNodes, m_elDim);
     m_elIntType = "Gauss" + std::to_string(2 * m_elOrder);
 
     // std::vector<double> m_elWeight;
-    gmsh::model::mesh::getIntegrationPoints(m_elType[0], m_elIntType, m_elParamCoord, m_elWeight);
+    model.getIntegrationPoints(m_elType[0], m_elIntType, m_elParamCoord, m_elWeight);
     // pp("integration points to integrate order " + std::to_string(m_elOrder*2) + " polynomials", m_elParamCoord, 3);
 
     screen_display::write_string("Elements - Compute Jacobian", GREEN);
@@ -58,21 +168,20 @@ Mesh::Mesh(Config config) : config(config)
 
     // screen_display::write_string("flag 0", RED);
 
-    int _numOrientations;
-    // const std::vector<int>& wantedOrientations = std::vector<int>()
-    int _numComponents;
-    gmsh::model::mesh::getBasisFunctions(m_elType[0], m_elParamCoord, config.elementType,
-                                         _numComponents, m_elBasisFcts, _numOrientations);
-    gmsh::model::mesh::getBasisFunctions(m_elType[0], m_elParamCoord, "Grad" + config.elementType,
-                                         _numComponents, m_elUGradBasisFcts, _numOrientations);
+    model.getBasisFunctions(m_elType[0], m_elParamCoord, config.elementType, m_elBasisFcts);
+    model.getBasisFunctions(m_elType[0], m_elParamCoord, "Grad" + config.elementType, m_elUGradBasisFcts);
 
     // screen_display::write_string(m_elIntType, RED);
     // screen_display::write_string("Grad" + config.elementType, RED);
     // gmsh::model::mesh::getBasisFunctions(m_elType[0], m_elIntType, "Grad" + config.elementType,
     //                                      m_elIntParamCoords, *new int, m_elUGradBasisFcts);
 
-    gmsh::model::mesh::getJacobians(m_elType[0], m_elParamCoord, m_elJacobians,
-                                    m_elJacobianDets, m_elIntPtCoords);
+    std::vector<double> jacobianDets;
+    model.getJacobians(m_elType[0], m_elParamCoord, m_elJacobians,
+                       jacobianDets, m_elIntPtCoords);
+    permuteElements(m_elJacobians, elPerm, config.numThreads);
+    permuteElements(jacobianDets, elPerm, config.numThreads);
+    permuteElements(m_elIntPtCoords, elPerm, config.numThreads);
 
     // std::ofstream _outfile_("m_elJacobians.txt");
     // _outfile_ << "size=" << m_elJacobians.size() << std::endl;
@@ -80,9 +189,9 @@ Mesh::Mesh(Config config) : config(config)
     //     _outfile_ << m_elJacobians[i] << std::endl;
     // _outfile_.close();
 
-    // pp("Jacobian determinants at integration points", m_elJacobianDets, 1);
+    // pp("Jacobian determinants at integration points", jacobianDets, 1);
 
-    m_elNumIntPts = (int)m_elJacobianDets.size() / m_elNum;
+    m_elNumIntPts = (int)jacobianDets.size() / m_elNum;
 
     auto end = std::chrono::system_clock::now();
     auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
@@ -105,14 +214,59 @@ Mesh::Mesh(Config config) : config(config)
      */
 
     start = std::chrono::system_clock::now();
-    std::vector<double> jacobian(m_elDim * m_elDim);
-    m_elGradBasisFcts.resize(m_elNum * m_elNumNodes * m_elNumIntPts * 3);
 
-    // #pragma omp parallel for
+    /**
+     * The jacobian of straight-sided simplices is constant over the element:
+     * only its inverse and determinant are stored and the gradients are
+     * reconstructed from m_elUGradBasisFcts in the kernels. The gradients
+     * and determinants of the curved elements are still tabulated at each
+     * integration point.
+     */
+    m_elCurvedIds.resize(m_elNum);
+    int numCurved = 0;
+    for (size_t el = 0; el < m_elNum; ++el)
+    {
+        double scale = 0.0, diff = 0.0;
+        for (int i = 0; i < m_elDim; ++i)
+            for (int j = 0; j < m_elDim; ++j)
+                scale = std::max(scale, std::fabs(elJacobian(el, 0, i, j)));
+        for (int g = 1; g < m_elNumIntPts; ++g)
+            for (int i = 0; i < m_elDim; ++i)
+                for (int j = 0; j < m_elDim; ++j)
+                    diff = std::max(diff, std::fabs(elJacobian(el, g, i, j) - elJacobian(el, 0, i, j)));
+        m_elCurvedIds[el] = (diff <= 1e-12 * scale) ? -1 : numCurved++;
+    }
+
+    m_elInvJacobians.assign(m_elNum * 9, 0.0);
+    m_elJacobianDets.assign(m_elNum, 0.0);
+    m_elCurvedJacobianDets.resize(numCurved * m_elNumIntPts);
+    m_elGradBasisFcts.assign(numCurved * m_elNumNodes * m_elNumIntPts * 3, 0.0);
+
+    /**
+     * Each element writes its own slice of m_elInvJacobians and
+     * m_elJacobianDets or of m_elGradBasisFcts and m_elCurvedJacobianDets,
+     * and the jacobian is a per-thread scratch.
+     */
+#pragma omp parallel for schedule(static) num_threads(config.numThreads)
     for (size_t el = 0; el < m_elNum; ++el)
     {
+        double jacobian[9];
+        if (elIsAffine(el))
+        {
+            for (int i = 0; i < m_elDim; ++i)
+                for (int j = 0; j < m_elDim; ++j)
+                    jacobian[i * m_elDim + j] = elJacobian(el, 0, i, j);
+            eigen::inverse(jacobian, m_elDim);
+            for (int u = 0; u < m_elDim; ++u)
+                for (int x = 0; x < m_elDim; ++x)
+                    elInvJacobian(el, u, x) = jacobian[u * m_elDim + x];
+            m_elJacobianDets[el] = jacobianDets[el * m_elNumIntPts];
+            continue;
+        }
+
         for (int g = 0; g < m_elNumIntPts; ++g)
         {
+            elJacobianDet(el, g) = jacobianDets[el * m_elNumIntPts + g];
             for (int f = 0; f < m_elNumNodes; ++f)
             {
                 // The copy operations are not required. They're simply enforced
@@ -121,41 +275,42 @@ Mesh::Mesh(Config config) : config(config)
                 {
                     for (int j = 0; j < m_elDim; ++j)
                     {
-                        // screen_display::write_value("elJacobian(el, g, i, j)",elJacobian(el, g, i, j),"");
                         jacobian[i * m_elDim + j] = elJacobian(el, g, i, j);
                     }
                 }
 
-                // std::cout<<"el = "<<el<<" - g = "<<g<<" - f = "<<f<<std::endl;
-                // screen_display::write_value("elUGradBasisFct(g, f)",elUGradBasisFct(g, f),"",BLUE);
-                // screen_display::write_value("elGradBasisFct(el, g, f)",elGradBasisFct(el, g, f),"",BLUE);
                 std::copy(&elUGradBasisFct(g, f), &elUGradBasisFct(g, f) + m_elDim, &elGradBasisFct(el, g, f));
-                eigen::solve(jacobian.data(), &elGradBasisFct(el, g, f), m_elDim);
-                // screen_display::write_string("flag 1", RED);
+                eigen::solve(jacobian, &elGradBasisFct(el, g, f), m_elDim);
             }
         }
     }
 
+    // The per integration point jacobians and coordinates are no longer needed
+    std::vector<double>().swap(m_elJacobians);
+    std::vector<double>().swap(m_elIntPtCoords);
+
     // pp("Element jacobian", jacobian, 1);
 
     assert(m_elType.size() == 1);
     assert(m_elNodeTags.size() == m_elNum * m_elNumNodes);
-    assert(m_elJacobianDets.size() == m_elNum * m_elNumIntPts);
+    assert(m_elJacobianDets.size() == m_elNum);
+    assert(m_elCurvedJacobianDets.size() == numCurved * m_elNumIntPts);
     assert(m_elBasisFcts.size() == m_elNumNodes * m_elNumIntPts);
-    assert(m_elGradBasisFcts.size() == m_elNum * m_elNumIntPts * m_elNumNodes * 3);
+    assert(m_elGradBasisFcts.size() == numCurved * m_elNumIntPts * m_elNumNodes * 3);
 
     end = std::chrono::system_clock::now();
     elapsed = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
     screen_display::write_value("Elapsed time:", elapsed.count() * 1.0e-6, "s", BLUE);
 
-    gmsh::logger::write("==================================================");
-    gmsh::logger::write("Number of Elements : " + std::to_string(m_elNum));
-    gmsh::logger::write("Element dimension : " + std::to_string(m_elDim));
-    gmsh::logger::write("Element Type : " + m_elName);
-    gmsh::logger::write("Element Order : " + std::to_string(m_elOrder));
-    gmsh::logger::write("Element Nbr Nodes : " + std::to_string(m_elNumNodes));
-    gmsh::logger::write("Integration type : " + m_elIntType);
-    gmsh::logger::write("Integration Nbr points : " + std::to_string(m_elNumIntPts));
+    screen_display::write_string("==================================================");
+    screen_display::write_string("Number of Elements : " + std::to_string(m_elNum));
+    screen_display::write_string("Element dimension : " + std::to_string(m_elDim));
+    screen_display::write_string("Element Type : " + m_elName);
+    screen_display::write_string("Element Order : " + std::to_string(m_elOrder));
+    screen_display::write_string("Element Nbr Nodes : " + std::to_string(m_elNumNodes));
+    screen_display::write_string("Integration type : " + m_elIntType);
+    screen_display::write_string("Integration Nbr points : " + std::to_string(m_elNumIntPts));
+    screen_display::write_string("Curved elements : " + std::to_string(numCurved));
 
     /******************************
      *            Faces           *
@@ -170,15 +325,16 @@ Mesh::Mesh(Config config) : config(config)
                                 : m_fDim == 2   ? (m_elOrder + 1) * (m_elOrder + 2) / 2
                                                 : 0; // Triangular elements only.
 
-    m_fType = gmsh::model::mesh::getElementType(m_fName, m_elOrder);
+    m_fType = model.getElementType(m_fName, m_elOrder);
 
     /**
      * [1] Get Faces for all elements
      */
     if (m_fDim < 2)
-        gmsh::model::mesh::getElementEdgeNodes(m_elType[0], m_elFNodeTags, -1);
+        model.getElementEdgeNodes(m_elType[0], m_elFNodeTags);
     else
-        gmsh::model::mesh::getElementFaceNodes(m_elType[0], 3, m_elFNodeTags, -1);
+        model.getElementFaceNodes(m_elType[0], 3, m_elFNodeTags);
+    permuteElements(m_elFNodeTags, elPerm, config.numThreads);
 
     m_fNumPerEl = m_elFNodeTags.size() / (m_elNum * m_fNumNodes);
     end = std::chrono::system_clock::now();
@@ -186,13 +342,14 @@ Mesh::Mesh(Config config) : config(config)
     screen_display::write_value("Elapsed time:", elapsed.count() * 1.0e-6, "s", BLUE);
     /**
      * [2] Remove the faces counted two times
-     *     i.e. common face between two elements.
+     *     i.e. common face between two elements,
+     *     and build the face/element connectivity.
      */
-    screen_display::write_string("Remove the faces counted two times", GREEN);
+    screen_display::write_string("Build the face topology", GREEN);
     start = std::chrono::system_clock::now();
 
     //! ////////////////////////////////
-    getUniqueFaceNodeTags();
+    buildFaceTopology();
     //! ////////////////////////////////
 
     end = std::chrono::system_clock::now();
@@ -206,15 +363,11 @@ Mesh::Mesh(Config config) : config(config)
      */
     screen_display::write_string("Create a single entity");
     start = std::chrono::system_clock::now();
-    m_fEntity = gmsh::model::addDiscreteEntity(m_fDim);
-
-    gmsh::model::mesh::addElementsByType(m_fEntity, m_fType, {}, m_fNodeTags);
+    m_fEntity = model.addElements(m_fDim, m_fType, m_fNodeTags);
 
     m_fIntType = m_elIntType;
 
-    gmsh::model::mesh::getIntegrationPoints(m_fType, m_fIntType, m_fIntParamCoords, m_fWeight);
-
-    m_fNum = m_fNodeTags.size() / m_fNumNodes;
+    model.getIntegrationPoints(m_fType, m_fIntType, m_fIntParamCoords, m_fWeight);
     end = std::chrono::system_clock::now();
     elapsed = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
     screen_display::write_value("Elapsed time:", elapsed.count() * 1.0e-6, "s", BLUE);
@@ -227,11 +380,11 @@ Mesh::Mesh(Config config) : config(config)
     start = std::chrono::system_clock::now();
     m_fIntType = m_elIntType;
 
-    gmsh::model::mesh::getBasisFunctions(m_fType, m_fIntParamCoords, config.elementType, *new int, m_fBasisFcts, _numOrientations);
+    model.getBasisFunctions(m_fType, m_fIntParamCoords, config.elementType, m_fBasisFcts);
 
-    gmsh::model::mesh::getBasisFunctions(m_fType, m_fIntParamCoords, "Grad" + config.elementType, *new int, m_fUGradBasisFcts, _numOrientations);
+    model.getBasisFunctions(m_fType, m_fIntParamCoords, "Grad" + config.elementType, m_fUGradBasisFcts);
 
-    gmsh::model::mesh::getJacobians(m_fType, m_fIntParamCoords, m_fJacobians, m_fJacobianDets, m_fIntPtCoords, m_fEntity);
+    model.getJacobians(m_fType, m_fIntParamCoords, m_fJacobians, m_fJacobianDets, m_fIntPtCoords, m_fEntity);
 
     m_fNumIntPts = (int)m_fJacobianDets.size() / m_fNum;
 
@@ -239,9 +392,10 @@ Mesh::Mesh(Config config) : config(config)
      * See element part for explanation. (line 40)
      */
     m_fGradBasisFcts.resize(m_fNum * m_fNumNodes * m_fNumIntPts * 3);
-    // #pragma omp parallel for
+#pragma omp parallel for schedule(static) num_threads(config.numThreads)
     for (int f = 0; f < m_fNum; ++f)
     {
+        double jacobian[9];
         for (int g = 0; g < m_fNumIntPts; ++g)
         {
             for (int n = 0; n < m_fNumNodes; ++n)
@@ -254,7 +408,7 @@ Mesh::Mesh(Config config) : config(config)
                     }
                 }
                 std::copy(/*std::execution::par,*/ &fUGradBasisFct(g, n), &fUGradBasisFct(g, n) + m_elDim, &fGradBasisFct(f, g, n));
-                eigen::solve(jacobian.data(), &fGradBasisFct(f, g, n), m_elDim);
+                eigen::solve(jacobian, &fGradBasisFct(f, g, n), m_elDim);
             }
         }
     }
@@ -270,12 +424,15 @@ Mesh::Mesh(Config config) : config(config)
 
     screen_display::write_string("Define a normal/tangent/bitangent (1D and 2D only, 3D in progress) associated to each surface.", GREEN);
     start = std::chrono::system_clock::now();
-    std::vector<double> normal(m_Dim);
-    std::vector<double> tangent(m_Dim);
-    std::vector<double> bitangent(m_Dim);
-    // #pragma omp parallel for
+    m_fNormals.assign(m_fNum * m_fNumIntPts * m_Dim, 0.0);
+    m_fTangents.assign(m_fNum * m_fNumIntPts * m_Dim, 0.0);
+    m_fBiTangents.assign(m_fNum * m_fNumIntPts * m_Dim, 0.0);
+#pragma omp parallel for schedule(static) num_threads(config.numThreads)
     for (int f = 0; f < m_fNum; ++f)
     {
+        std::vector<double> normal(m_Dim);
+        std::vector<double> tangent(m_Dim);
+        std::vector<double> bitangent(m_Dim);
         // compute here tangent and bitangent for 3D cases
 
         std::vector<double> T = {0, 0, 0};
@@ -357,9 +514,9 @@ Mesh::Mesh(Config config) : config(config)
             eigen::normalize(normal.data(), m_Dim);
             eigen::normalize(tangent.data(), m_Dim);
             eigen::normalize(bitangent.data(), m_Dim);
-            m_fNormals.insert(m_fNormals.end(), normal.begin(), normal.end());
-            m_fTangents.insert(m_fTangents.end(), tangent.begin(), tangent.end());
-            m_fBiTangents.insert(m_fBiTangents.end(), bitangent.begin(), bitangent.end());
+            std::copy(normal.begin(), normal.end(), &fNormal(f, g));
+            std::copy(tangent.begin(), tangent.end(), &fTangent(f, g));
+            std::copy(bitangent.begin(), bitangent.end(), &fBiTangent(f, g));
         }
     }
 
@@ -377,61 +534,15 @@ Mesh::Mesh(Config config) : config(config)
     elapsed = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
     screen_display::write_value("Elapsed time:", elapsed.count() * 1.0e-6, "s", BLUE);
 
-    gmsh::logger::write("==================================================");
-    gmsh::logger::write("Number of Faces : " + std::to_string(m_fNum));
-    gmsh::logger::write("Faces per Element : " + std::to_string(m_fNumPerEl));
-    gmsh::logger::write("Face dimension : " + std::to_string(m_fDim));
-    gmsh::logger::write("Face Type : " + m_fName);
-    gmsh::logger::write("Face Nbr Nodes : " + std::to_string(m_fNumNodes));
-    gmsh::logger::write("Integration type : " + m_fIntType);
-    gmsh::logger::write("Integration Nbr points : " + std::to_string(m_fNumIntPts));
-
-    /******************************
-     *       Connectivity         *
-     ******************************/
-
-    /**
-     * Assign corresponding faces to each element, we use the
-     * fact that the node tags per face has already been ordered
-     */
-    screen_display::write_string("Connectivity: Assign corresponding faces to each element", GREEN);
-    start = std::chrono::system_clock::now();
-
-    //! ////////////////////////////////
-    getConnectivityFaceToElement();
-    //! ////////////////////////////////
-
-    end = std::chrono::system_clock::now();
-    elapsed = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
-    screen_display::write_value("Elapsed time:", elapsed.count() * 1.0e-6, "s", BLUE);
-
-    /**
-     * For efficiency purposes we also directly store the mapping
-     * between face node id and element node id. For example, the
-     * 3rd node of the face correspond to the 7th of the element.
-     */
-    screen_display::write_string("Store the mapping between face node id and element node id", GREEN);
-    start = std::chrono::system_clock::now();
+    screen_display::write_string("==================================================");
+    screen_display::write_string("Number of Faces : " + std::to_string(m_fNum));
+    screen_display::write_string("Faces per Element : " + std::to_string(m_fNumPerEl));
+    screen_display::write_string("Face dimension : " + std::to_string(m_fDim));
+    screen_display::write_string("Face Type : " + m_fName);
+    screen_display::write_string("Face Nbr Nodes : " + std::to_string(m_fNumNodes));
+    screen_display::write_string("Integration type : " + m_fIntType);
+    screen_display::write_string("Integration Nbr points : " + std::to_string(m_fNumIntPts));
 
-    m_fNToElNIds.resize(m_fNum);
-    // #pragma omp parallel for
-    for (int f = 0; f < m_fNum; ++f)
-    {
-        for (int nf = 0; nf < m_fNumNodes; ++nf)
-        {
-            for (size_t el : m_fNbrElIds[f])
-            {
-                for (int nel = 0; nel < m_elNumNodes; ++nel)
-                {
-                    if (fNodeTag(f, nf) == elNodeTag(el, nel))
-                        m_fNToElNIds[f].push_back(nel);
-                }
-            }
-        }
-    }
-    end = std::chrono::system_clock::now();
-    elapsed = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
-    screen_display::write_value("Elapsed time:", elapsed.count() * 1.0e-6, "s", BLUE);
     /**
      * Up to now, the normals are associated to the faces.
      * We still need to know how the normal is oriented
@@ -449,30 +560,32 @@ Mesh::Mesh(Config config) : config(config)
     screen_display::write_string("Define normals orientation", GREEN);
     start = std::chrono::system_clock::now();
 
-    double dotProduct;
-    std::vector<double> m_elBarycenters, fNodeCoord(3), elOuterDir(3), paramCoords;
-    gmsh::model::mesh::getBarycenters(m_elType[0], -1, false, true, m_elBarycenters);
+    std::vector<double> m_elBarycenters;
+    model.getBarycenters(m_elType[0], m_elBarycenters);
+    permuteElements(m_elBarycenters, elPerm, config.numThreads);
 
-    m_elFOrientation.clear();
+    m_elFOrientation.resize(m_elNum * m_fNumPerEl);
 
+#pragma omp parallel for schedule(static) num_threads(config.numThreads)
     for (size_t el = 0; el < m_elNum; ++el)
     {
+        double elOuterDir[3];
         for (int f = 0; f < m_fNumPerEl; ++f)
         {
-            dotProduct = 0.0;
-
-            int _dim, _tag;
+            double dotProduct = 0.0;
 
-            gmsh::model::mesh::getNode(elFNodeTag(el, f), fNodeCoord, paramCoords, _dim, _tag);
+            int nel = 0;
+            while (elNodeTag(el, nel) != elFNodeTag(el, f))
+                ++nel;
 
             for (int x = 0; x < m_Dim; x++)
             {
-                elOuterDir[x] = fNodeCoord[x] - m_elBarycenters[el * 3 + x];
+                elOuterDir[x] = elNodeCoord(el, nel, x) - m_elBarycenters[el * 3 + x];
                 dotProduct += elOuterDir[x] * fNormal(elFId(el, f), 0, x);
             }
 
             size_t value = (dotProduct >= 0) ? 1 : -1;
-            m_elFOrientation.push_back(value);
+            elFOrientation(el, f) = value;
         }
     }
 
@@ -488,20 +601,20 @@ Mesh::Mesh(Config config) : config(config)
     screen_display::write_string("Reclassification of the neighbouring elements", GREEN);
     start = std::chrono::system_clock::now();
 
-    size_t elf;
-    // #pragma omp parallel for
+#pragma omp parallel for schedule(static) num_threads(config.numThreads)
     for (int f = 0; f < m_fNum; ++f)
     {
+        size_t elf = 0;
         for (int lf = 0; lf < m_fNumPerEl; ++lf)
         {
             if (elFId(fNbrElId(f, 0), lf) == f)
                 elf = lf;
         }
-        if (m_fNbrElIds.size() == 2)
+        if (m_fNum == 2)
         {
             if (elFOrientation(fNbrElId(f, 0), elf) <= 0)
             {
-                std::swap(m_fNbrElIds[f][0], m_fNbrElIds[f][1]);
+                std::swap(fNbrElId(f, 0), fNbrElId(f, 1));
                 for (int nf = 0; nf < m_fNumNodes; ++nf)
                     std::swap(fNToElNId(f, nf, 0), fNToElNId(f, nf, 1));
             }
@@ -515,8 +628,8 @@ Mesh::Mesh(Config config) : config(config)
     elapsed = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
     screen_display::write_value("Elapsed time:", elapsed.count() * 1.0e-6, "s", BLUE);
 
-    gmsh::logger::write("==================================================");
-    gmsh::logger::write("Element-Face connectivity retrieved.");
+    screen_display::write_string("==================================================");
+    screen_display::write_string("Element-Face connectivity retrieved.");
     start = std::chrono::system_clock::now();
     //---------------------------------------------------------------------
     // Boundary conditions
@@ -532,77 +645,39 @@ Mesh::Mesh(Config config) : config(config)
      * This convention is particularly useful for BCs.
      */
     screen_display::write_string("Boundary conditions", GREEN);
-    // #pragma omp parallel for
-    for (int f = 0; f < m_fNum; ++f)
+    // Each (element, local face) pair belongs to a single face (no race)
+#pragma omp parallel for schedule(static) num_threads(config.numThreads)
+    for (size_t k = 0; k < m_fBoundaryIds.size(); ++k)
     {
-        if (m_fNbrElIds[f].size() < 2)
+        int f = m_fBoundaryIds[k];
+        for (int lf = 0; lf < m_fNumPerEl; ++lf)
         {
-            m_fIsBoundary.push_back(true);
-            for (int lf = 0; lf < m_fNumPerEl; ++lf)
+            if (elFId(fNbrElId(f, 0), lf) == f)
             {
-                if (elFId(fNbrElId(f, 0), lf) == f)
+                for (int g = 0; g < m_fNumIntPts; ++g)
                 {
-                    for (int g = 0; g < m_fNumIntPts; ++g)
-                    {
-                        // #pragma omp atomic
-                        fNormal(f, g, 0) *= elFOrientation(fNbrElId(f, 0), lf);
-                        // fTangent(f, g, 0) *= elFOrientation(fNbrElId(f, 0), lf);
-                        // fBiTangent(f, g, 0) *= elFOrientation(fNbrElId(f, 0), lf);
-                        // #pragma omp atomic
-                        fNormal(f, g, 1) *= elFOrientation(fNbrElId(f, 0), lf);
-                        // fTangent(f, g, 1) *= elFOrientation(fNbrElId(f, 0), lf);
-                        // fBiTangent(f, g, 1) *= elFOrientation(fNbrElId(f, 0), lf);
-                        // #pragma omp atomic
-                        fNormal(f, g, 2) *= elFOrientation(fNbrElId(f, 0), lf);
-                        // fTangent(f, g, 2) *= elFOrientation(fNbrElId(f, 0), lf);
-                        // fBiTangent(f, g, 2) *= elFOrientation(fNbrElId(f, 0), lf);
-                    }
-                    elFOrientation(fNbrElId(f, 0), lf) = 1;
+                    // #pragma omp atomic
+                    fNormal(f, g, 0) *= elFOrientation(fNbrElId(f, 0), lf);
+                    // fTangent(f, g, 0) *= elFOrientation(fNbrElId(f, 0), lf);
+                    // fBiTangent(f, g, 0) *= elFOrientation(fNbrElId(f, 0), lf);
+                    // #pragma omp atomic
+                    fNormal(f, g, 1) *= elFOrientation(fNbrElId(f, 0), lf);
+                    // fTangent(f, g, 1) *= elFOrientation(fNbrElId(f, 0), lf);
+                    // fBiTangent(f, g, 1) *= elFOrientation(fNbrElId(f, 0), lf);
+                    // #pragma omp atomic
+                    fNormal(f, g, 2) *= elFOrientation(fNbrElId(f, 0), lf);
+                    // fTangent(f, g, 2) *= elFOrientation(fNbrElId(f, 0), lf);
+                    // fBiTangent(f, g, 2) *= elFOrientation(fNbrElId(f, 0), lf);
                 }
+                elFOrientation(fNbrElId(f, 0), lf) = 1;
             }
         }
-        else
-        {
-            m_fIsBoundary.push_back(false);
-        }
     }
 
     /**
-     * Iterate over the physical boundaries and over each nodes
-     * belonging to that boundary. Retrieve the associated face and assign
-     * it an unique integer representing the BC type.
-     *
-     * 1        : Reflecting
-     * 2        : Absorbing
-     * Default  : Absorbing (!= 1 or 2)
+     * The BC type of each boundary face (1: Reflecting, 0: Absorbing) has
+     * already been retrieved from the physical groups in buildFaceTopology.
      */
-    m_fBC.resize(m_fNum);
-    std::vector<size_t> nodeTags;
-    std::vector<double> coord;
-    for (auto const &physBC : config.physBCs)
-    {
-        auto physTag = physBC.first;
-        auto BCtype = physBC.second.first;
-        auto BCvalue = physBC.second.second;
-
-        gmsh::model::mesh::getNodesForPhysicalGroup(m_fDim, physTag, nodeTags, coord);
-        if (BCtype == "Reflecting")
-        {
-            for (int f = 0; f < m_fNum; ++f)
-            {
-                if (m_fIsBoundary[f] && std::find(nodeTags.begin(), nodeTags.end(), fNodeTag(f)) != nodeTags.end())
-                    m_fBC[f] = 1;
-            }
-        }
-        else
-        {
-            for (int f = 0; f < m_fNum; ++f)
-            {
-                if (m_fIsBoundary[f] && std::find(nodeTags.begin(), nodeTags.end(), fNodeTag(f)) != nodeTags.end())
-                    m_fBC[f] = 0;
-            }
-        }
-    }
     end = std::chrono::system_clock::now();
     elapsed = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
     screen_display::write_value("Elapsed time:", elapsed.count() * 1.0e-6, "s", BLUE);
@@ -616,16 +691,20 @@ Mesh::Mesh(Config config) : config(config)
     screen_display::write_string("Compute the R*K*R matrix product", GREEN);
     start = std::chrono::system_clock::now();
 
-    RKR.resize(m_fNum * m_fNumIntPts);
+    // Absorbing faces only. Zero mean flow: the absorbing flux is computed
+    // from the normal (see updateFlux)
+    const int numAbsorbing = m_fBoundaryIds.size() - m_fNumReflecting;
+    RKR.assign(m_quiescent ? 0 : (size_t)numAbsorbing * m_fNumIntPts * 16, 0.0);
 
-    // #pragma omp parallel for
-    for (int f = 0; f < m_fNum; ++f)
+#pragma omp parallel for schedule(static) num_threads(config.numThreads)
+    for (int a = 0; a < numAbsorbing; ++a)
     {
-        if (m_fBC[f] == 0)
+        int f = m_fBoundaryIds[m_fNumReflecting + a];
+        if (!m_quiescent)
         {
             for (int g = 0; g < m_fNumIntPts; ++g)
             {
-                int i = f * m_fNumIntPts + g;
+                double *rkr = &RKR[(a * m_fNumIntPts + g) * 16];
                 double nx(fNormal(f, g, 0)), ny(fNormal(f, g, 1)), nz(fNormal(f, g, 2));
                 double tx(fTangent(f, g, 0)), ty(fTangent(f, g, 1)), tz(fTangent(f, g, 2));
                 double sx(fBiTangent(f, g, 0)), sy(fBiTangent(f, g, 1)), sz(fBiTangent(f, g, 2));
@@ -640,62 +719,212 @@ Mesh::Mesh(Config config) : config(config)
                 // screen_display::write_value("lambda",lambda);
                 // getchar();
 
-                RKR[i].resize(16);
-
-                RKR[i][0] = 0.25 * (c0 + vn0);
-                RKR[i][1] = 0.25 * (c0 * rho0 * (c0 + vn0) * nx);
-                RKR[i][2] = 0.25 * (c0 * rho0 * (c0 + vn0) * ny);
-                RKR[i][3] = 0.25 * (c0 * rho0 * (c0 + vn0) * nz);
-
-                RKR[i][4] = 0.25 * (nx * (c0 + vn0) / (rho0 * c0));
-                RKR[i][5] = 0.25 * ((c0 + vn0) * nx * nx - vn0 * lambda * (tx * tx + sx * sx));
-                RKR[i][6] = 0.25 * ((c0 + vn0) * nx * ny - vn0 * lambda * (ty * tx + sy * sx));
-                RKR[i][7] = 0.25 * ((c0 + vn0) * nx * nz - vn0 * lambda * (tz * tx + sz * sx));
-
-                RKR[i][8] = 0.25 * (ny * (c0 + vn0) / (rho0 * c0));
-                RKR[i][9] = 0.25 * ((c0 + vn0) * ny * nx - vn0 * lambda * (tx * ty + sx * sy));
-                RKR[i][10] = 0.25 * ((c0 + vn0) * ny * ny - vn0 * lambda * (ty * ty + sy * sy));
-                RKR[i][11] = 0.25 * ((c0 + vn0) * ny * nz - vn0 * lambda * (tz * ty + sz * sy));
-
-                RKR[i][12] = 0.25 * (nz * (c0 + vn0) / (rho0 * c0));
-                RKR[i][13] = 0.25 * ((c0 + vn0) * nz * nx - vn0 * lambda * (tx * tz + sx * sz));
-                RKR[i][14] = 0.25 * ((c0 + vn0) * nz * ny - vn0 * lambda * (ty * tz + sy * sz));
-                RKR[i][15] = 0.25 * ((c0 + vn0) * nz * nz - vn0 * lambda * (tz * tz + sz * sz));
+                rkr[0] = 0.25 * (c0 + vn0);
+                rkr[1] = 0.25 * (c0 * rho0 * (c0 + vn0) * nx);
+                rkr[2] = 0.25 * (c0 * rho0 * (c0 + vn0) * ny);
+                rkr[3] = 0.25 * (c0 * rho0 * (c0 + vn0) * nz);
+
+                rkr[4] = 0.25 * (nx * (c0 + vn0) / (rho0 * c0));
+                rkr[5] = 0.25 * ((c0 + vn0) * nx * nx - vn0 * lambda * (tx * tx + sx * sx));
+                rkr[6] = 0.25 * ((c0 + vn0) * nx * ny - vn0 * lambda * (ty * tx + sy * sx));
+                rkr[7] = 0.25 * ((c0 + vn0) * nx * nz - vn0 * lambda * (tz * tx + sz * sx));
+
+                rkr[8] = 0.25 * (ny * (c0 + vn0) / (rho0 * c0));
+                rkr[9] = 0.25 * ((c0 + vn0) * ny * nx - vn0 * lambda * (tx * ty + sx * sy));
+                rkr[10] = 0.25 * ((c0 + vn0) * ny * ny - vn0 * lambda * (ty * ty + sy * sy));
+                rkr[11] = 0.25 * ((c0 + vn0) * ny * nz - vn0 * lambda * (tz * ty + sz * sy));
+
+                rkr[12] = 0.25 * (nz * (c0 + vn0) / (rho0 * c0));
+                rkr[13] = 0.25 * ((c0 + vn0) * nz * nx - vn0 * lambda * (tx * tz + sx * sz));
+                rkr[14] = 0.25 * ((c0 + vn0) * nz * ny - vn0 * lambda * (ty * tz + sy * sz));
+                rkr[15] = 0.25 * ((c0 + vn0) * nz * nz - vn0 * lambda * (tz * tz + sz * sz));
             }
         }
     }
 
     assert(m_fIsBoundary.size() == m_fNum);
 
-    /**
-     * Extra Memory allocation:
-     * Instantiate Ghost Elements and numerical flux storage.
-     */
-    m_fFlux.resize(m_fNum * m_fNumNodes);
-    uGhost = std::vector<std::vector<double>>(4,
-                                              std::vector<double>(m_fNum * m_fNumIntPts));
-    FluxGhost = std::vector<std::vector<std::vector<double>>>(4,
-                                                              std::vector<std::vector<double>>(m_fNum * m_fNumIntPts,
-                                                                                               std::vector<double>(3)));
-
-    gmsh::logger::write("Boundary conditions successfuly loaded.");
-    gmsh::logger::write("==================================================");
+    screen_display::write_string("Boundary conditions successfuly loaded.");
+    screen_display::write_string("==================================================");
     end = std::chrono::system_clock::now();
     elapsed = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
     screen_display::write_value("Elapsed time:", elapsed.count() * 1.0e-6, "s", BLUE);
 }
 
 /**
- * Precompute and store the mass matris for all elements in m_elMassMatrix
+ * Order of the elements along a Morton (Z-order) curve: the barycenters
+ * are quantized on 21 bits per direction within the mesh bounding box and
+ * their bits interleaved. Ties are broken by the original element id.
+ *
+ * @return Old element id of each new element id
+ */
+std::vector<uint32_t> Mesh::mortonOrder()
+{
+    std::vector<double> barycenters(m_elNum * 3, 0.0);
+#pragma omp parallel for schedule(static) num_threads(config.numThreads)
+    for (size_t el = 0; el < m_elNum; ++el)
+    {
+        for (int n = 0; n < m_elNumPrimaryNodes; ++n)
+            for (int x = 0; x < 3; ++x)
+                barycenters[el * 3 + x] += elNodeCoord(el, n, x) / m_elNumPrimaryNodes;
+    }
+
+    double lo[3], hi[3];
+    for (int x = 0; x < 3; ++x)
+    {
+        lo[x] = std::numeric_limits<double>::max();
+        hi[x] = std::numeric_limits<double>::lowest();
+    }
+    for (size_t el = 0; el < m_elNum; ++el)
+    {
+        for (int x = 0; x < 3; ++x)
+        {
+            lo[x] = std::min(lo[x], barycenters[el * 3 + x]);
+            hi[x] = std::max(hi[x], barycenters[el * 3 + x]);
+        }
+    }
+
+    // Spread the 21 lowest bits of a value every 3 bits
+    auto spread = [](uint64_t v)
+    {
+        v &= 0x1fffff;
+        v = (v | v << 32) & 0x1f00000000ffff;
+        v = (v | v << 16) & 0x1f0000ff0000ff;
+        v = (v | v << 8) & 0x100f00f00f00f00f;
+        v = (v | v << 4) & 0x10c30c30c30c30c3;
+        v = (v | v << 2) & 0x1249249249249249;
+        return v;
+    };
+
+    std::vector<uint64_t> keys(m_elNum);
+#pragma omp parallel for schedule(static) num_threads(config.numThreads)
+    for (size_t el = 0; el < m_elNum; ++el)
+    {
+        keys[el] = 0;
+        for (int x = 0; x < 3; ++x)
+        {
+            double t = (hi[x] > lo[x]) ? (barycenters[el * 3 + x] - lo[x]) / (hi[x] - lo[x]) : 0.0;
+            keys[el] |= spread((uint64_t)(t * 0x1fffff)) << x;
+        }
+    }
+
+    std::vector<uint32_t> perm(m_elNum);
+    std::iota(perm.begin(), perm.end(), 0);
+    __gnu_parallel::sort(perm.begin(), perm.end(), [&](uint32_t a, uint32_t b)
+                         { return keys[a] != keys[b] ? keys[a] < keys[b] : a < b; });
+    return perm;
+}
+
+/**
+ * Precompute and store the inverse mass matrices. The mass matrix of an
+ * affine element is the reference one scaled by the jacobian determinant,
+ * hence a single reference inverse is stored for all of them. The curved
+ * elements keep their own inverse in m_elMassMatrices.
  */
 void Mesh::precomputeMassMatrix()
 {
-    m_elMassMatrices.resize(m_elNum * m_elNumNodes * m_elNumNodes);
-    // #pragma omp parallel for
+    // Already built by the constructor or loaded from the mesh cache.
+    if (m_refMassMatrix.size() == m_elNumNodes * m_elNumNodes)
+        return;
+
+    m_refMassMatrix.assign(m_elNumNodes * m_elNumNodes, 0.0);
+    for (int i = 0; i < m_elNumNodes; ++i)
+    {
+        for (int j = 0; j < m_elNumNodes; ++j)
+        {
+            for (int g = 0; g < m_elNumIntPts; g++)
+                m_refMassMatrix[i * m_elNumNodes + j] += elBasisFct(g, i) * elBasisFct(g, j) * m_elWeight[g];
+        }
+    }
+    eigen::inverse(m_refMassMatrix.data(), m_elNumNodes);
+
+    size_t numCurved = m_elNum - std::count(m_elCurvedIds.begin(), m_elCurvedIds.end(), -1);
+    m_elMassMatrices.resize(numCurved * m_elNumNodes * m_elNumNodes);
+#pragma omp parallel for schedule(static) num_threads(config.numThreads)
     for (size_t el = 0; el < m_elNum; ++el)
     {
-        getElMassMatrix(el, true, &elMassMatrix(el));
+        if (!elIsAffine(el))
+            getElMassMatrix(el, true, &elMassMatrix(el));
+    }
+}
+
+/**
+ * Precompute the reference weak differentiation matrices, one per
+ * parametric direction d: D_d(i, j) = sum_g w_g * dphi_i/du_d(g) * phi_j(g).
+ * The volume term of an affine element is then a single matrix/vector
+ * product with the contravariant flux (see getElStiffVector).
+ */
+void Mesh::precomputeDiffMatrices()
+{
+    m_elRefDiffMatrices.assign(m_elNumNodes * m_elDim * m_elNumNodes, 0.0);
+    for (int i = 0; i < m_elNumNodes; ++i)
+    {
+        for (int d = 0; d < m_elDim; ++d)
+        {
+            for (int j = 0; j < m_elNumNodes; ++j)
+            {
+                double &Dij = m_elRefDiffMatrices[(i * m_elDim + d) * m_elNumNodes + j];
+                for (int g = 0; g < m_elNumIntPts; g++)
+                    Dij += m_elWeight[g] * elUGradBasisFct(g, i, d) * elBasisFct(g, j);
+            }
+        }
+    }
+}
+
+/**
+ * Precompute the reference face lift matrix: L(n, g) = w_g * phi_n(g).
+ * Multiplied by the numerical flux scaled by the surface jacobian at the
+ * face integration points, it gives the surface integral at the face nodes.
+ */
+void Mesh::precomputeLiftMatrix()
+{
+    m_fLiftMatrix.resize(m_fNumNodes * m_fNumIntPts);
+    for (int n = 0; n < m_fNumNodes; ++n)
+        for (int g = 0; g < m_fNumIntPts; ++g)
+            m_fLiftMatrix[n * m_fNumIntPts + g] = m_fWeight[g] * fBasisFct(g, n);
+}
+
+/**
+ * Precompute the flux jacobians of the linearized Euler equations,
+ * F_eq,x = sum_k A_x(eq, k) * u_k, with u = (p, vx, vy, vz):
+ * A_x(eq, eq) = v0_x, A_x(p, v_x) = rho0 * c0^2 and A_x(v_x, p) = 1 / rho0.
+ */
+void Mesh::precomputeFluxJacobians()
+{
+    m_fluxJacobians.assign(3 * 16, 0.0);
+    for (int x = 0; x < 3; ++x)
+    {
+        for (int eq = 0; eq < 4; ++eq)
+            fluxJacobian(x, eq, eq) = config.v0[x];
+        fluxJacobian(x, 0, 1 + x) = config.rho0 * config.c0 * config.c0;
+        fluxJacobian(x, 1 + x, 0) = 1.0 / config.rho0;
+    }
+}
+
+/**
+ * Estimate the inscribed radius of each element: r = dim * V / S, with V the
+ * volume (area) of the element and S the area (length) of its boundary, both
+ * integrated with the quadrature rules. Exact for straight simplices.
+ * The largest wave speed is the speed of sound plus the mean flow speed.
+ */
+void Mesh::precomputeInRadii()
+{
+    m_elInRadius.resize(m_elNum);
+#pragma omp parallel for schedule(static) num_threads(config.numThreads)
+    for (int el = 0; el < m_elNum; ++el)
+    {
+        double volume = 0, surface = 0;
+        for (int g = 0; g < m_elNumIntPts; ++g)
+            volume += m_elWeight[g] * std::abs(elJacobianDet(el, g));
+        for (int k = 0; k < m_fNumPerEl; ++k)
+            for (int g = 0; g < m_fNumIntPts; ++g)
+                surface += m_fWeight[g] * std::abs(fJacobianDet(elFId(el, k), g));
+        m_elInRadius[el] = m_elDim * volume / surface;
     }
+    m_waveSpeed = config.c0 + std::sqrt(eigen::dot(config.v0.data(), config.v0.data(), 3));
+
+    double minInRadius = *std::min_element(m_elInRadius.begin(), m_elInRadius.end());
+    screen_display::write_value("Smallest inscribed radius:", minInRadius, "", BLUE);
 }
 
 /**
@@ -724,26 +953,51 @@ void Mesh::getElMassMatrix(const size_t el, const bool inverse, double *elMassMa
 }
 
 /**
- * Compute the element stiffness/convection matrix.
+ * Compute the element stiffness/convection matrix. The physical flux of the
+ * equation is evaluated at the element nodes from u and the flux jacobians.
  *
  * @param el integer : element id
- * @param Flux double array : physical flux
- * @param u double array : solution at element node
+ * @param u double array : nodal solution, for each equation
+ * @param eq integer : equation id (0 = pressure, 1 = velocity x, 2= vy, 3= vz)
  * @param elStiffVector double array : Output storage of the element stiffness vector
  */
-void Mesh::getElStiffVector(const size_t el, std::vector<std::vector<double>> &Flux,
-                            std::vector<double> &u, double *elStiffVector)
+void Mesh::getElStiffVector(const size_t el, SolutionField &u, const int eq,
+                            double *elStiffVector)
 {
-    int jId;
+    thread_local std::vector<double> elNodalFlux;
+    elNodalFlux.resize(m_elNumNodes * 3);
+    for (int j = 0; j < m_elNumNodes; ++j)
+        getPhysFlux(u, el * m_elNumNodes + j, eq, &elNodalFlux[j * 3]);
+
+    if (elIsAffine(el))
+    {
+        /**
+         * Constant jacobian: S = detJ * [D_u D_v D_w] * [Fu; Fv; Fw], with the
+         * contravariant flux Fu_j = sum_x du/dx * F_j,x at each node.
+         */
+        thread_local std::vector<double> contravariantFlux;
+        contravariantFlux.resize(m_elDim * m_elNumNodes);
+        for (int j = 0; j < m_elNumNodes; ++j)
+        {
+            for (int d = 0; d < m_elDim; ++d)
+                contravariantFlux[d * m_elNumNodes + j] = eigen::dot(&elInvJacobian(el, d), &elNodalFlux[j * 3], m_Dim);
+        }
+
+        Eigen::Map<const Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>>
+            D(m_elRefDiffMatrices.data(), m_elNumNodes, m_elDim * m_elNumNodes);
+        Eigen::Map<Eigen::VectorXd> S(elStiffVector, m_elNumNodes);
+        S.noalias() = elJacobianDet(el, 0) * (D * Eigen::Map<const Eigen::VectorXd>(contravariantFlux.data(), m_elDim * m_elNumNodes));
+        return;
+    }
+
     for (int i = 0; i < m_elNumNodes; ++i)
     {
         elStiffVector[i] = 0.0;
         for (int j = 0; j < m_elNumNodes; ++j)
         {
-            jId = el * m_elNumNodes + j;
             for (int g = 0; g < m_elNumIntPts; g++)
             {
-                elStiffVector[i] += eigen::dot(Flux[jId].data(), &elGradBasisFct(el, g, i), m_Dim) *
+                elStiffVector[i] += eigen::dot(&elNodalFlux[j * 3], &elGradBasisFct(el, g, i), m_Dim) *
                                     elBasisFct(g, j) * m_elWeight[g] * elJacobianDet(el, g);
             }
         }
@@ -751,400 +1005,706 @@ void Mesh::getElStiffVector(const size_t el, std::vector<std::vector<double>> &F
 }
 
 /**
- * Precompute the numerical flux through all the faces. The flux implemented is
- * the Rusanov Flux. Also note that the following code is paralelized using openMP.
+ * Precompute the numerical flux through all the faces for the four equations
+ * in a single pass over the faces. The flux implemented is the Rusanov Flux:
+ * the normal physical flux is applied to u through the flux jacobians.
+ * Each face owns its flux values: the faces are shared between the threads
+ * by a single static loop, without atomics nor scratch memory.
  *
- * @param Flux double array : physical flux
- * @param u double array : solution at the node
- * @param eq : equation id (0 = pressure, 1 = velocity x, 2= vy, 3= vz)
+ * @param u double array : solution at the nodes, for each equation
+ *                         (0 = pressure, 1 = velocity x, 2= vy, 3= vz)
  */
-void Mesh::precomputeFlux(std::vector<double> &u, std::vector<std::vector<double>> &Flux, int eq)
+void Mesh::precomputeFlux(SolutionField &u)
 {
+    precomputeFlux(u, config.numThreads);
+}
 
-#pragma omp parallel num_threads(config.numThreads)
-    {
-        // Memory allocation (Cross-plateform compatibility)
-        size_t elUp, elDn;
-        std::vector<double> FIntPts(m_fNumIntPts, 0);
-        std::vector<double> Fnum(m_Dim, 0);
+/**
+ * Same as precomputeFlux(u), with a given number of threads.
+ */
+void Mesh::precomputeFlux(SolutionField &u, int numThreads)
+{
+#pragma omp parallel num_threads(numThreads)
+    precomputeFluxShared(u);
+}
 
-#pragma omp parallel for schedule(static)
-        for (int f = 0; f < m_fNum; ++f)
-        {
+/**
+ * Same as precomputeFlux(u), work-shared between the threads of the
+ * enclosing parallel region: every thread of the team must call it.
+ * Ends with a barrier, the flux is complete on return.
+ */
+void Mesh::precomputeFluxShared(SolutionField &u)
+{
+    precomputeFluxShared(u, -1);
+}
+
+/**
+ * Same as precomputeFluxShared(u), restricted to the faces of level <= maxLevel
+ * (see setTimeLevels), all the faces if maxLevel < 0.
+ */
+void Mesh::precomputeFluxShared(SolutionField &u, int maxLevel)
+{
+    int numInterior, numReflecting, numAbsorbing;
+    levelFaceCounts(maxLevel, numInterior, numReflecting, numAbsorbing);
+    if (m_quiescent)
+        precomputeFluxImpl<true>(u, numInterior, numReflecting, numAbsorbing);
+    else
+        precomputeFluxImpl<false>(u, numInterior, numReflecting, numAbsorbing);
+}
 
-            std::fill(FIntPts.begin(), FIntPts.end(), 0);
+/**
+ * Numerical flux through the first numInterior interior faces, numReflecting
+ * reflecting faces and numAbsorbing absorbing faces (see precomputeFlux), for
+ * a general mean flow or for a quiescent medium (sparse normal flux jacobian).
+ * The interior faces come first in the loop, then the boundary faces which
+ * only take the flux of their ghost element.
+ */
+template <bool QUIESCENT>
+void Mesh::precomputeFluxImpl(SolutionField &u, int numInterior, int numReflecting, int numAbsorbing)
+{
+    const int numFaces = numInterior + numReflecting + numAbsorbing;
 
-            // Numerical Flux at Integration points
-            if (m_fIsBoundary[f])
-            {
+#pragma omp for schedule(static)
+    for (int k = 0; k < numFaces; ++k)
+    {
+        // Boundary faces: flux of the ghost elements
+        if (k >= numInterior)
+        {
+            int b = k - numInterior;
+            if (b >= numReflecting)
+                b += m_fNumReflecting - numReflecting;
+            int f = m_fBoundaryIds[b];
+            for (int eq = 0; eq < 4; ++eq)
                 for (int g = 0; g < m_fNumIntPts; ++g)
-                    FIntPts[g] = FluxGhost[eq][f * m_fNumIntPts + g][0];
+                    fFlux(f, eq, g) = FluxGhost.el(eq, b)[g] * fJacobianDet(f, g);
+            continue;
+        }
+
+        // Numerical Flux at Integration points of the interior faces
+        int f = m_fInteriorIds[k];
+        double An[16];
+        for (int g = 0; g < m_fNumIntPts; ++g)
+        {
+            // Normal flux jacobian An = sum_x n_x * A_x and penalty coefficient
+            const double *n = &fNormal(f, g);
+            if constexpr (!QUIESCENT)
+            {
+                for (int ij = 0; ij < 16; ++ij)
+                    An[ij] = n[0] * m_fluxJacobians[ij] + n[1] * m_fluxJacobians[16 + ij] + n[2] * m_fluxJacobians[32 + ij];
             }
-            else
+            double penalty = fc * config.c0 * eigen::dot(&fNormal(f, g), &fNormal(f, g), m_Dim);
+
+            double FIntPt[4] = {0, 0, 0, 0};
+            for (int i = 0; i < m_fNumNodes; ++i)
             {
-                for (int i = 0; i < m_fNumNodes; ++i)
+                size_t elUp = (size_t)fNbrElId(f, 0) * m_elNumNodes + fNToElNId(f, i, 0);
+                size_t elDn = (size_t)fNbrElId(f, 1) * m_elNumNodes + fNToElNId(f, i, 1);
+                double uSum[4], uJump[4];
+                for (int eq = 0; eq < 4; ++eq)
+                {
+                    uSum[eq] = u[eq][elUp] + u[eq][elDn];
+                    uJump[eq] = u[eq][elUp] - u[eq][elDn];
+                }
+                for (int eq = 0; eq < 4; ++eq)
                 {
-                    elUp = fNbrElId(f, 0) * m_elNumNodes + fNToElNId(f, i, 0);
-                    elDn = fNbrElId(f, 1) * m_elNumNodes + fNToElNId(f, i, 1);
-                    for (int g = 0; g < m_fNumIntPts; ++g)
+                    double Fnum;
+                    if constexpr (QUIESCENT)
                     {
-                        for (int x = 0; x < m_Dim; ++x)
-                            Fnum[x] = 0.5 * ((Flux[elUp][x] + Flux[elDn][x]) + fc * config.c0 * fNormal(f, g, x) * (u[elUp] - u[elDn]));
-/////////////////////////
-#pragma omp atomic update
-                        FIntPts[g] += eigen::dot(&fNormal(f, g), Fnum.data(), m_Dim) * fBasisFct(g, i);
+                        // An(p, v_x) = n_x * rho0 * c0^2 and An(v_x, p) = n_x / rho0 only
+                        double AnU = (eq == 0) ? fluxJacobian(0, 0, 1) * (n[0] * uSum[1] + n[1] * uSum[2] + n[2] * uSum[3])
+                                               : n[eq - 1] * fluxJacobian(0, 1, 0) * uSum[0];
+                        Fnum = 0.5 * (AnU + penalty * uJump[eq]);
                     }
+                    else
+                        Fnum = 0.5 * (eigen::dot(&An[eq * 4], uSum, 4) + penalty * uJump[eq]);
+                    FIntPt[eq] += Fnum * fBasisFct(g, i);
                 }
             }
 
-            // Surface integral
-            for (int n = 0; n < m_fNumNodes; ++n)
-            {
-                fFlux(f, n) = 0;
-                for (int g = 0; g < m_fNumIntPts; ++g)
-                {
-////////////////////////
-#pragma omp atomic update
-                    fFlux(f, n) += m_fWeight[g] * fBasisFct(g, n) * FIntPts[g] * fJacobianDet(f, g);
-                }
-            }
+            // Surface jacobian scaling: the reference lift is applied in getElFlux
+            for (int eq = 0; eq < 4; ++eq)
+                fFlux(f, eq, g) = FIntPt[eq] * fJacobianDet(f, g);
         }
     }
 }
 
 /**
- * Compute flux through a given element from
- * the value of the flux at the face.
+ * Compute the stiffness vectors of the elements [el0, el0 + numEl), stored
+ * one column per element (numNodes x numEl, column major). The affine
+ * elements of the block share a single product of the reference
+ * differentiation matrices with the block of contravariant fluxes
+ * (scaled by detJ); the curved elements are integrated one by one.
  *
- * @param el integer : element id
- * @param F double array : Output element flux
+ * @param el0 integer : first element id of the block
+ * @param numEl integer : number of elements in the block
+ * @param u double array : solution at the nodes, for each equation
+ * @param eq integer : equation id
+ * @param blockStiffVectors double array : Output stiffness vectors
  */
-void Mesh::getElFlux(const size_t el, double *F)
+void Mesh::getBlockStiffVectors(const size_t el0, const int numEl, SolutionField &u,
+                                const int eq, double *blockStiffVectors)
 {
-    int i;
-    std::fill(F, F + m_elNumNodes, 0);
-    // #pragma omp parallel num_threads(config.numThreads)
+    const int K = m_elDim * m_elNumNodes;
+    thread_local std::vector<double> contravariantFlux;
+    contravariantFlux.resize(K * numEl);
+
+    for (int k = 0; k < numEl; ++k)
     {
-        // #pragma omp parallel for schedule(static)
-        for (int f = 0; f < m_fNumPerEl; ++f)
+        size_t el = el0 + k;
+        double *Fc = &contravariantFlux[k * K];
+        if (!elIsAffine(el))
         {
-            el == fNbrElId(elFId(el, f), 0) ? i = 0 : i = 1;
-            for (int nf = 0; nf < m_fNumNodes; ++nf)
-            {
-                // #pragma omp atomic
-                F[fNToElNId(elFId(el, f), nf, i)] += elFOrientation(el, f) * fFlux(elFId(el, f), nf);
-            }
+            std::fill(Fc, Fc + K, 0);
+            continue;
         }
+        double det = elJacobianDet(el, 0);
+        double F[3];
+        for (int j = 0; j < m_elNumNodes; ++j)
+        {
+            getPhysFlux(u, el * m_elNumNodes + j, eq, F);
+            for (int d = 0; d < m_elDim; ++d)
+                Fc[d * m_elNumNodes + j] = det * eigen::dot(&elInvJacobian(el, d), F, m_Dim);
+        }
+    }
+
+    lapack::gemm(m_elRefDiffMatrices.data(), contravariantFlux.data(), blockStiffVectors,
+                 1.0, 0.0, m_elNumNodes, numEl, K);
+
+    for (int k = 0; k < numEl; ++k)
+    {
+        if (!elIsAffine(el0 + k))
+            getElStiffVector(el0 + k, u, eq, blockStiffVectors + k * m_elNumNodes);
     }
 }
 
 /**
- * Compute physical flux from the nodal solution. Also update
- * the ghost element and numerical flux.
+ * Fill the operators, geometry and state pointers of a batch of
+ * consecutive affine elements [el0, el0 + numEl) for the SIMD kernels.
+ * The output is u itself (in place update). The surface term, time step
+ * and beta are left to the caller.
  *
- * @param u : nodal solution vector
- * @param Flux : Physical flux
- * @param v0 : mean flow speed (v0x,v0y,v0z)
- * @param c0 : speed of sound
- * @param rho0: mean flow density
+ * @param el0 integer : first element id of the batch
+ * @param numEl integer : number of elements in the batch (<= simd::maxWidth)
+ * @param u double array : solution at the nodes, for each equation
+ * @param batch : Output batch
  */
-void Mesh::updateFlux(std::vector<std::vector<double>> &u, std::vector<std::vector<std::vector<double>>> &Flux,
-                      std::vector<double> &v0, double c0, double rho0)
+void Mesh::getAffineBatch(const size_t el0, const int numEl, SolutionField &u, simd::AffineBatch &batch)
 {
+    batch.numNodes = m_elNumNodes;
+    batch.dim = m_elDim;
+    batch.D = m_elRefDiffMatrices.data();
+    batch.M = m_refMassMatrix.data();
+    batch.A = m_fluxJacobians.data();
+    batch.invJ = &elInvJacobian(el0);
+    for (int l = 0; l < numEl; ++l)
+        batch.det[l] = m_elJacobianDets[el0 + l];
+    for (int k = 0; k < 4; ++k)
+        batch.u[k] = batch.y[k] = u.el(k, el0);
+}
 
-// #pragma omp parallel for
-#pragma omp parallel for schedule(static) num_threads(config.numThreads)
-    for (size_t el = 0; el < m_elNum; ++el)
+/**
+ * Compute flux through a given element from
+ * the value of the flux at the face integration points, for the four
+ * equations at once: one product of the reference lift matrix with the
+ * [numIntPts x (numFaces * 4)] block of oriented face fluxes,
+ * scattered to the element nodes.
+ *
+ * FNN and FNUM are the number of nodes per face and of faces per element of
+ * the specialized kernels, 0 for the generic one (see selectKernels).
+ *
+ * @param el integer : element id
+ * @param F double array : Output element flux [eq0n1, eq0n2, ..., eq1n1, ...]
+ */
+template <int FNN, int FNUM>
+void Mesh::getElFluxImpl(const size_t el, double *F)
+{
+    constexpr int Rows = FNN > 0 ? FNN : Eigen::Dynamic;
+    constexpr int Cols = FNUM > 0 ? FNUM * 4 : Eigen::Dynamic;
+    const int fNumNodes = FNN > 0 ? FNN : m_fNumNodes;
+    const int fNumPerEl = FNUM > 0 ? FNUM : m_fNumPerEl;
+    const int numCols = fNumPerEl * 4;
+
+    thread_local std::vector<double> elFFlux;
+    elFFlux.resize(m_fNumIntPts * numCols);
+    alignas(64) double fixedNodalFlux[FNN > 0 ? FNN * FNUM * 4 : 1];
+    double *elFNodalFlux = fixedNodalFlux;
+    if constexpr (FNN == 0)
+    {
+        thread_local std::vector<double> dynNodalFlux;
+        dynNodalFlux.resize(fNumNodes * numCols);
+        elFNodalFlux = dynNodalFlux.data();
+    }
+
+    for (int lf = 0; lf < fNumPerEl; ++lf)
     {
-        for (int n = 0; n < m_elNumNodes; ++n)
+        int f = elFId(el, lf);
+        double orientation = elFOrientation(el, lf);
+        for (int k = 0; k < 4 * m_fNumIntPts; ++k)
+            elFFlux[lf * 4 * m_fNumIntPts + k] = orientation * (&fFlux(f))[k];
+    }
+
+    Eigen::Map<const Eigen::Matrix<double, Rows, Eigen::Dynamic, Eigen::RowMajor>>
+        L(m_fLiftMatrix.data(), fNumNodes, m_fNumIntPts);
+    Eigen::Map<Eigen::Matrix<double, Rows, Cols>> Fn(elFNodalFlux, fNumNodes, numCols);
+    Fn.noalias() = L * Eigen::Map<const Eigen::Matrix<double, Eigen::Dynamic, Cols>>(elFFlux.data(), m_fNumIntPts, numCols);
+
+    std::fill(F, F + 4 * m_elNumNodes, 0);
+    for (int lf = 0; lf < fNumPerEl; ++lf)
+    {
+        int f = elFId(el, lf);
+        int i = (el == fNbrElId(f, 0)) ? 0 : 1;
+        for (int nf = 0; nf < fNumNodes; ++nf)
         {
-            int i = el * m_elNumNodes + n;
-
-            // Pressure flux
-            Flux[0][i] = {v0[0] * u[0][i] + rho0 * c0 * c0 * u[1][i],
-                          v0[1] * u[0][i] + rho0 * c0 * c0 * u[2][i],
-                          v0[2] * u[0][i] + rho0 * c0 * c0 * u[3][i]};
-            // Vx
-            Flux[1][i] = {v0[0] * u[1][i] + u[0][i] / rho0,
-                          v0[1] * u[1][i],
-                          v0[2] * u[1][i]};
-            // Vy
-            Flux[2][i] = {v0[0] * u[2][i],
-                          v0[1] * u[2][i] + u[0][i] / rho0,
-                          v0[2] * u[2][i]};
-            // Vz
-            Flux[3][i] = {v0[0] * u[3][i],
-                          v0[1] * u[3][i],
-                          v0[2] * u[3][i] + u[0][i] / rho0};
+            int n = fNToElNId(f, nf, i);
+            for (int eq = 0; eq < 4; ++eq)
+                F[eq * m_elNumNodes + n] += Fn(nf, lf * 4 + eq);
         }
+    }
+}
 
-        // Ghost elements
-        for (int f = 0; f < m_fNumPerEl; ++f)
-        {
-            int fId = elFId(el, f);
-            if (m_fIsBoundary[fId])
-            {
+/**
+ * Y = beta*Y + alpha*M^-1*X with the inverse mass matrix of an element,
+ * NN nodes per element for the specialized kernels, 0 for the generic one.
+ */
+template <int NN>
+void Mesh::elMassUpdateImpl(const size_t el, const double *X, double *Y, const double alpha, const double beta)
+{
+    if constexpr (NN == 0)
+    {
+        int N = m_elNumNodes;
+        double a = alpha;
+        eigen::linEq(&elMassMatrix(el), const_cast<double *>(X), Y, a, beta, N);
+    }
+    else
+    {
+        // Symmetric matrix: the row major storage is read column major, as eigen::linEq
+        Eigen::Map<const Eigen::Matrix<double, NN, NN>> M(&elMassMatrix(el));
+        Eigen::Map<Eigen::Matrix<double, NN, 1>> y(Y);
+        y = beta * y + alpha * (M * Eigen::Map<const Eigen::Matrix<double, NN, 1>>(X));
+    }
+}
 
-                for (int g = 0; g < m_fNumIntPts; ++g)
-                {
-                    int gId = fId * m_fNumIntPts + g;
-
-                    // Interpolate solution at integration points
-                    uGhost[0][gId] = 0;
-                    uGhost[1][gId] = 0;
-                    uGhost[2][gId] = 0;
-                    uGhost[3][gId] = 0;
-                    for (int n = 0; n < m_fNumNodes; ++n)
-                    {
-                        int nId = el * m_elNumNodes + fNToElNId(fId, n, 0);
-////////////////////////
-#pragma omp atomic
-                        uGhost[0][gId] += u[0][nId] * fBasisFct(g, n);
-#pragma omp atomic
-                        uGhost[1][gId] += u[1][nId] * fBasisFct(g, n);
-#pragma omp atomic
-                        uGhost[2][gId] += u[2][nId] * fBasisFct(g, n);
-#pragma omp atomic
-                        uGhost[3][gId] += u[3][nId] * fBasisFct(g, n);
-                    }
+/**
+ * Select the element kernels specialized for the element type of the mesh:
+ * triangles and tetrahedra of order 1 to 4. Other elements use the generic
+ * kernels with runtime sizes. A zero mean flow selects the quiescent
+ * affine kernels.
+ */
+void Mesh::selectKernels()
+{
+    struct ElKernels
+    {
+        int dim;
+        int order;
+        int numNodes;
+        int fNumNodes;
+        int fNumPerEl;
+        ElFluxKernel flux;
+        ElMassKernel mass;
+    };
+    static const ElKernels kernels[] = {
+        {2, 1, 3, 2, 3, &Mesh::getElFluxImpl<2, 3>, &Mesh::elMassUpdateImpl<3>},
+        {2, 2, 6, 3, 3, &Mesh::getElFluxImpl<3, 3>, &Mesh::elMassUpdateImpl<6>},
+        {2, 3, 10, 4, 3, &Mesh::getElFluxImpl<4, 3>, &Mesh::elMassUpdateImpl<10>},
+        {2, 4, 15, 5, 3, &Mesh::getElFluxImpl<5, 3>, &Mesh::elMassUpdateImpl<15>},
+        {3, 1, 4, 3, 4, &Mesh::getElFluxImpl<3, 4>, &Mesh::elMassUpdateImpl<4>},
+        {3, 2, 10, 6, 4, &Mesh::getElFluxImpl<6, 4>, &Mesh::elMassUpdateImpl<10>},
+        {3, 3, 20, 10, 4, &Mesh::getElFluxImpl<10, 4>, &Mesh::elMassUpdateImpl<20>},
+        {3, 4, 35, 15, 4, &Mesh::getElFluxImpl<15, 4>, &Mesh::elMassUpdateImpl<35>},
+    };
 
-                    if (m_fBC[fId] == 1)
-                    {
-                        double nx(fNormal(fId, g, 0)), ny(fNormal(fId, g, 1)), nz(fNormal(fId, g, 2));
-                        double dot = nx * uGhost[1][gId] +
-                                     ny * uGhost[2][gId] +
-                                     nz * uGhost[3][gId];
-// #pragma omp critical
-                        // std::cout << nx << " " << ny << " " << nz << std::endl;
-
-// Remove normal component (Rigid Wall BC)
-#pragma omp atomic
-                        uGhost[1][gId] -= dot * nx;
-#pragma omp atomic
-                        uGhost[2][gId] -= dot * ny;
-#pragma omp atomic
-                        uGhost[3][gId] -= dot * nz;
-
-                        // Flux at integration points
-                        // 1) Pressure flux
-                        FluxGhost[0][gId] = {v0[0] * uGhost[0][gId] + rho0 * c0 * c0 * uGhost[1][gId],
-                                             v0[1] * uGhost[0][gId] + rho0 * c0 * c0 * uGhost[2][gId],
-                                             v0[2] * uGhost[0][gId] + rho0 * c0 * c0 * uGhost[3][gId]};
-                        // 2) Vx
-                        FluxGhost[1][gId] = {v0[0] * uGhost[1][gId] + uGhost[0][gId] / rho0,
-                                             v0[1] * uGhost[1][gId],
-                                             v0[2] * uGhost[1][gId]};
-                        // 3) Vy
-                        FluxGhost[2][gId] = {v0[0] * uGhost[2][gId],
-                                             v0[1] * uGhost[2][gId] + uGhost[0][gId] / rho0,
-                                             v0[2] * uGhost[2][gId]};
-                        // 4) Vz
-                        FluxGhost[3][gId] = {v0[0] * uGhost[3][gId],
-                                             v0[1] * uGhost[3][gId],
-                                             v0[2] * uGhost[3][gId] + uGhost[0][gId] / rho0};
-
-                        // Project Flux on the normal
-                        for (int eq = 0; eq < 4; ++eq)
-                            FluxGhost[eq][gId][0] = eigen::dot(&fNormal(fId, g), &FluxGhost[eq][gId][0], m_Dim);
-                    }
-                    else
-                    {
-                        // Absorbing boundary conditions
-                        // /!\ Flux already projected on normal,
-                        FluxGhost[0][gId][0] = RKR[gId][0] * uGhost[0][gId] +
-                                               RKR[gId][1] * uGhost[1][gId] +
-                                               RKR[gId][2] * uGhost[2][gId] +
-                                               RKR[gId][3] * uGhost[3][gId];
-                        FluxGhost[1][gId][0] = RKR[gId][4] * uGhost[0][gId] +
-                                               RKR[gId][5] * uGhost[1][gId] +
-                                               RKR[gId][6] * uGhost[2][gId] +
-                                               RKR[gId][7] * uGhost[3][gId];
-                        FluxGhost[2][gId][0] = RKR[gId][8] * uGhost[0][gId] +
-                                               RKR[gId][9] * uGhost[1][gId] +
-                                               RKR[gId][10] * uGhost[2][gId] +
-                                               RKR[gId][11] * uGhost[3][gId];
-                        FluxGhost[3][gId][0] = RKR[gId][12] * uGhost[0][gId] +
-                                               RKR[gId][13] * uGhost[1][gId] +
-                                               RKR[gId][14] * uGhost[2][gId] +
-                                               RKR[gId][15] * uGhost[3][gId];
-                    }
-                }
-            }
+    std::string specialization = "generic";
+    m_elFluxKernel = &Mesh::getElFluxImpl<0, 0>;
+    m_elMassKernel = &Mesh::elMassUpdateImpl<0>;
+    for (const ElKernels &k : kernels)
+    {
+        if (k.dim == m_elDim && k.numNodes == m_elNumNodes &&
+            k.fNumNodes == m_fNumNodes && k.fNumPerEl == m_fNumPerEl)
+        {
+            m_elFluxKernel = k.flux;
+            m_elMassKernel = k.mass;
+            specialization = "P" + std::to_string(k.order) + (k.dim == 2 ? " triangles" : " tetrahedra");
         }
     }
+
+    m_simdIsa = simd::select(config.simd);
+    m_affineUpdate = simd::affineUpdate(m_simdIsa, m_elDim, m_elNumNodes, m_quiescent);
+    screen_display::write_string("Element kernels: " + simd::name(m_simdIsa) + ", " + specialization +
+                                     (m_quiescent ? ", quiescent medium" : ""),
+                                 GREEN);
 }
 
 /**
- * List of nodes for each unique face given a list of node per face and per elements
+ * Update the normal flux of the ghost elements at the integration points of
+ * the boundary faces. The boundary faces are grouped by BC type, each group
+ * is processed by its own kernel: the cost only depends on the boundary size.
+ * The mean flow (v0, c0, rho0) is the one of the configuration.
+ *
+ * @param u : nodal solution vector
  */
+void Mesh::updateFlux(SolutionField &u)
+{
+#pragma omp parallel num_threads(config.numThreads)
+    updateFluxShared(u);
+}
 
-void Mesh::getUniqueFaceNodeTags()
+/**
+ * Same as updateFlux, work-shared between the threads of the enclosing
+ * parallel region: every thread of the team must call it. Ends with a
+ * barrier, the ghost flux is complete on return.
+ */
+void Mesh::updateFluxShared(SolutionField &u)
 {
-    // Ordering per face for efficient comparison
-    m_elFNodeTagsOrdered = m_elFNodeTags;
-    // #pragma omp parallel for
-    for (int i = 0; i < m_elFNodeTagsOrdered.size(); i += m_fNumNodes)
-        std::sort(/*std::execution::par,*/ m_elFNodeTagsOrdered.begin() + i, m_elFNodeTagsOrdered.begin() + (i + m_fNumNodes));
+    updateFluxShared(u, -1);
+}
 
-    screen_display::write_string("get Unique Face Node Tags", RED);
+/**
+ * Same as updateFluxShared(u), restricted to the boundary faces of level
+ * <= maxLevel (see setTimeLevels), all of them if maxLevel < 0.
+ */
+void Mesh::updateFluxShared(SolutionField &u, int maxLevel)
+{
+    int numInterior, numReflecting, numAbsorbing;
+    levelFaceCounts(maxLevel, numInterior, numReflecting, numAbsorbing);
+    if (m_quiescent)
+        updateFluxImpl<true>(u, numReflecting, numAbsorbing);
+    else
+        updateFluxImpl<false>(u, numReflecting, numAbsorbing);
+}
 
-    m_fNodeTags = m_elFNodeTags;
-    std::vector<size_t> m_fNodeTags_t;
-    std::vector<size_t> m_fNodeTags_tmp;
-    std::vector<std::vector<size_t>> m_fNodeTags_tab;
-    size_t fNumNativeNodes;
+/**
+ * Ghost element flux of the first numReflecting reflecting faces and
+ * numAbsorbing absorbing faces (see updateFlux), for a general mean flow or
+ * for a quiescent medium. The ghost solution at a boundary integration point
+ * is the solution of the element interpolated at that point.
+ */
+template <bool QUIESCENT>
+void Mesh::updateFluxImpl(SolutionField &u, int numReflecting, int numAbsorbing)
+{
+    const int numBoundary = m_fNumReflecting + numAbsorbing;
 
-    //! TIMER start ////////////////////////////////
-    auto start = std::chrono::system_clock::now();
-    //! ////////////////////////////////////////////
-    if (m_fDim < 2)
+    auto interpolate = [&](int f, int g, double *uG)
     {
-        screen_display::write_string("Create and get all egdes", BLUE);
-        std::vector<size_t> edge_tags;
-        gmsh::model::mesh::createEdges();
-        gmsh::model::mesh::getAllEdges(edge_tags, m_fNodeTags_t);
-        fNumNativeNodes = 2;
-
-        std::vector<std::vector<size_t>> m_fNodeTags_tab_full = vector_to_matrix(m_fNodeTags, m_fNumNodes);
-        std::vector<std::vector<size_t>> m_fNodeTags_t_tab = vector_to_matrix(m_fNodeTags_t, fNumNativeNodes);
+        size_t el = fNbrElId(f, 0);
+        uG[0] = uG[1] = uG[2] = uG[3] = 0;
+        for (int n = 0; n < m_fNumNodes; ++n)
+        {
+            size_t nId = el * m_elNumNodes + fNToElNId(f, n, 0);
+            for (int eq = 0; eq < 4; ++eq)
+                uG[eq] += u[eq][nId] * fBasisFct(g, n);
+        }
+    };
 
-        for (size_t i = 0; i < m_fNodeTags_tab_full.size(); i++)
+    // Reflecting faces: rigid wall, the normal velocity of the ghost is removed
+#pragma omp for schedule(static) nowait
+    for (int k = 0; k < numReflecting; ++k)
+    {
+        int f = m_fBoundaryIds[k];
+        for (int g = 0; g < m_fNumIntPts; ++g)
         {
-            for (size_t j = 0; j < m_fNodeTags_t_tab.size(); j++)
+            double uG[4];
+            interpolate(f, g, uG);
+            const double *n = &fNormal(f, g);
+            double dot = n[0] * uG[1] + n[1] * uG[2] + n[2] * uG[3];
+            uG[1] -= dot * n[0];
+            uG[2] -= dot * n[1];
+            uG[3] -= dot * n[2];
+
+            // Normal flux: sum_x n_x * A_x * uGhost
+            if constexpr (QUIESCENT)
             {
-                if (isNCoincidentValues2d(m_fNodeTags_tab_full[i], m_fNodeTags_t_tab[j]))
+                FluxGhost.el(0, k)[g] = fluxJacobian(0, 0, 1) * (n[0] * uG[1] + n[1] * uG[2] + n[2] * uG[3]);
+                for (int x = 0; x < 3; ++x)
+                    FluxGhost.el(1 + x, k)[g] = n[x] * fluxJacobian(0, 1, 0) * uG[0];
+            }
+            else
+            {
+                for (int eq = 0; eq < 4; ++eq)
                 {
-                    m_fNodeTags_tab.push_back(m_fNodeTags_tab_full[i]);
-                    erase_row_from_matrix(m_fNodeTags_t_tab, j);
-                    break;
+                    double Fn = 0;
+                    for (int x = 0; x < m_Dim; ++x)
+                        for (int j = 0; j < 4; ++j)
+                            Fn += n[x] * fluxJacobian(x, eq, j) * uG[j];
+                    FluxGhost.el(eq, k)[g] = Fn;
                 }
             }
         }
     }
-    else
+
+    // Absorbing faces: flux already projected on the normal, R*K*R^-1 * uGhost
+#pragma omp for schedule(static)
+    for (int k = m_fNumReflecting; k < numBoundary; ++k)
+    {
+        int f = m_fBoundaryIds[k];
+        for (int g = 0; g < m_fNumIntPts; ++g)
+        {
+            double uG[4];
+            interpolate(f, g, uG);
+            if constexpr (QUIESCENT)
+            {
+                // Zero mean flow: R*K*R^-1 = c0/4 * (1, n/(rho0*c0)) (1, rho0*c0*n)^T
+                const double *n = &fNormal(f, g);
+                double Z = config.rho0 * config.c0;
+                double w = 0.25 * config.c0 * (uG[0] + Z * (n[0] * uG[1] + n[1] * uG[2] + n[2] * uG[3]));
+                FluxGhost.el(0, k)[g] = w;
+                for (int x = 0; x < 3; ++x)
+                    FluxGhost.el(1 + x, k)[g] = w * n[x] / Z;
+            }
+            else
+            {
+                const double *rkr = &RKR[((k - m_fNumReflecting) * m_fNumIntPts + g) * 16];
+                for (int eq = 0; eq < 4; ++eq)
+                    FluxGhost.el(eq, k)[g] = rkr[eq * 4 + 0] * uG[0] + rkr[eq * 4 + 1] * uG[1] +
+                                             rkr[eq * 4 + 2] * uG[2] + rkr[eq * 4 + 3] * uG[3];
+            }
+        }
+    }
+}
+
+/**
+ * Build the face topology with a single sort-and-scan pass. Each element face
+ * is keyed by its sorted node tags, so that sorting the keys gathers the two
+ * occurrences of an interior face next to each other. From that ordering we
+ * retrieve the unique faces (numbered by first occurrence), the element to
+ * face map, the neighbouring elements of each face, the face node to element
+ * node map and the boundary tagging from the physical groups.
+ */
+void Mesh::buildFaceTopology()
+{
+    const size_t elFNum = m_elFNodeTags.size() / m_fNumNodes;
+
+    // Ordering per face for efficient comparison
+    m_elFNodeTagsOrdered = m_elFNodeTags;
+#pragma omp parallel for schedule(static) num_threads(config.numThreads)
+    for (size_t i = 0; i < elFNum; ++i)
+        std::sort(m_elFNodeTagsOrdered.begin() + i * m_fNumNodes, m_elFNodeTagsOrdered.begin() + (i + 1) * m_fNumNodes);
+
+    auto isSameFace = [&](size_t a, size_t b)
     {
-        screen_display::write_string("Create and get all faces", BLUE);
-        std::vector<size_t> face_tags;
-        gmsh::model::mesh::createFaces();
-        gmsh::model::mesh::getAllFaces(3, face_tags, m_fNodeTags_t);
-        fNumNativeNodes = 3;
+        return std::equal(&m_elFNodeTagsOrdered[a * m_fNumNodes], &m_elFNodeTagsOrdered[(a + 1) * m_fNumNodes],
+                          &m_elFNodeTagsOrdered[b * m_fNumNodes]);
+    };
 
-        std::vector<std::vector<size_t>> m_fNodeTags_tab_full = vector_to_matrix(m_fNodeTags, m_fNumNodes);
-        std::vector<std::vector<size_t>> m_fNodeTags_t_tab = vector_to_matrix(m_fNodeTags_t, fNumNativeNodes);
+    /**
+     * [1] Sort the element faces by key. Ties are broken by position, hence
+     *     the first entry of each group is the first occurrence of the face.
+     */
+    std::vector<size_t> order(elFNum);
+    std::iota(order.begin(), order.end(), 0);
+    __gnu_parallel::sort(order.begin(), order.end(), [&](size_t a, size_t b)
+                         {
+                             const size_t *keyA = &m_elFNodeTagsOrdered[a * m_fNumNodes];
+                             const size_t *keyB = &m_elFNodeTagsOrdered[b * m_fNumNodes];
+                             for (int n = 0; n < m_fNumNodes; ++n)
+                             {
+                                 if (keyA[n] != keyB[n])
+                                     return keyA[n] < keyB[n];
+                             }
+                             return a < b; });
+
+    /**
+     * [2] Scan the sorted keys: each group of identical keys is a unique face.
+     *     Faces are numbered by first occurrence in the element face list.
+     */
+    std::vector<size_t> groupStart;
+    for (size_t k = 0; k < elFNum; ++k)
+    {
+        if (k == 0 || !isSameFace(order[k - 1], order[k]))
+            groupStart.push_back(k);
+    }
+    groupStart.push_back(elFNum);
+    size_t groupNum = groupStart.size() - 1;
+
+    std::vector<size_t> headFId(elFNum, 0);
+    for (size_t gr = 0; gr < groupNum; ++gr)
+        headFId[order[groupStart[gr]]] = 1;
+    m_fNum = 0;
+    for (size_t i = 0; i < elFNum; ++i)
+    {
+        if (headFId[i])
+            headFId[i] = m_fNum++;
+    }
 
-        for (size_t i = 0; i < m_fNodeTags_tab_full.size(); i++)
+    /**
+     * [3] Fill the face node tags and the face/element connectivity.
+     *     Each group is handled by a single thread (no race).
+     */
+    m_fNodeTags.resize(m_fNum * m_fNumNodes);
+    m_fNodeTagsOrdered.resize(m_fNum * m_fNumNodes);
+    if (elFNum > std::numeric_limits<uint32_t>::max() || m_elNum > std::numeric_limits<uint32_t>::max())
+        Fatal_Error("Mesh too large for 32 bits face/element indices")
+
+    const uint32_t noElement = std::numeric_limits<uint32_t>::max();
+    m_elFIds.resize(elFNum);
+    m_fNbrElIds.assign(m_fNum * 2, noElement);
+    m_fNToElNIds.assign(m_fNum * m_fNumNodes * 2, noElement);
+    bool isConforming = true;
+
+#pragma omp parallel for schedule(static) num_threads(config.numThreads) reduction(&& : isConforming)
+    for (size_t gr = 0; gr < groupNum; ++gr)
+    {
+        size_t head = order[groupStart[gr]];
+        size_t f = headFId[head];
+        isConforming = isConforming && (groupStart[gr + 1] - groupStart[gr] <= 2);
+
+        std::copy(&m_elFNodeTags[head * m_fNumNodes], &m_elFNodeTags[(head + 1) * m_fNumNodes], &fNodeTag(f));
+        std::copy(&m_elFNodeTagsOrdered[head * m_fNumNodes], &m_elFNodeTagsOrdered[(head + 1) * m_fNumNodes], &fNodeTagOrdered(f));
+
+        int numSides = std::min<int>(groupStart[gr + 1] - groupStart[gr], 2);
+        for (size_t k = groupStart[gr]; k < groupStart[gr + 1]; ++k)
+            m_elFIds[order[k]] = f;
+        for (int side = 0; side < numSides; ++side)
+            fNbrElId(f, side) = order[groupStart[gr] + side] / m_fNumPerEl;
+
+        /**
+         * For efficiency purposes we also directly store the mapping
+         * between face node id and element node id. For example, the
+         * 3rd node of the face correspond to the 7th of the element.
+         */
+        for (int nf = 0; nf < m_fNumNodes; ++nf)
         {
-            for (size_t j = 0; j < m_fNodeTags_t_tab.size(); j++)
+            for (int side = 0; side < numSides; ++side)
             {
-                if (isNCoincidentValues3d(m_fNodeTags_tab_full[i], m_fNodeTags_t_tab[j]))
+                for (int nel = 0; nel < m_elNumNodes; ++nel)
                 {
-                    m_fNodeTags_tab.push_back(m_fNodeTags_tab_full[i]);
-                    erase_row_from_matrix(m_fNodeTags_t_tab, j);
-                    break;
+                    if (fNodeTag(f, nf) == elNodeTag(fNbrElId(f, side), nel))
+                        fNToElNId(f, nf, side) = nel;
                 }
             }
         }
+    }
+    screen_display::write_if_false(isConforming, "Non conforming mesh: a face is shared by more than two elements");
 
-        // auto inner_loop = [&](std::vector<size_t> &V)
-        // {
-        //     for (size_t j = 0; j < m_fNodeTags_t_tab.size(); j++)
-        //     {
-        //         if (isNCoincidentValues3d(V, m_fNodeTags_t_tab[j])) // fNumNativeNodes
-        //         {
-        //             m_fNodeTags_tab.push_back(V);
-        //             erase_row_from_matrix(m_fNodeTags_t_tab, j);
-        //             break;
-        //         }
-        //     }
-        // };
-        // for_each(m_fNodeTags_tab_full.begin(), m_fNodeTags_tab_full.end(), inner_loop);
+    /**
+     * [4] A face with a single neighbouring element is a boundary. Iterate over
+     *     the physical boundaries and retrieve the faces whose first node belongs
+     *     to that boundary. Assign it an unique integer representing the BC type
+     *     and group the boundary faces by BC type.
+     *
+     * 1        : Reflecting
+     * 2        : Absorbing
+     * Default  : Absorbing (!= 1 or 2)
+     */
+    m_fIsBoundary.resize(m_fNum);
+    m_fInteriorIds.clear();
+    m_fBoundaryIds.clear();
+    for (int f = 0; f < m_fNum; ++f)
+    {
+        m_fIsBoundary[f] = (fNbrElId(f, 1) == noElement);
+        (m_fIsBoundary[f] ? m_fBoundaryIds : m_fInteriorIds).push_back(f);
     }
 
-    size_t tmp;
-    // m_fNodeTags.clear();
-    m_fNodeTags = matrix_to_vector(m_fNodeTags_tab, tmp);
-    // m_fNodeTagsOrdered.clear();
-    m_fNodeTagsOrdered = m_fNodeTags;
-    for (int i = 0; i < m_fNodeTagsOrdered.size(); i += m_fNumNodes)
-        std::sort(/*std::execution::par,*/ m_fNodeTagsOrdered.begin() + i, m_fNodeTagsOrdered.begin() + (i + m_fNumNodes));
+    m_fBC.assign(m_fNum, 0);
+    std::vector<size_t> nodeTags;
+    for (auto const &physBC : config.physBCs)
+    {
+        auto physTag = physBC.first;
+        auto BCtype = physBC.second.first;
+        size_t BCvalue = (BCtype == "Reflecting") ? 1 : 0;
+
+        meshModel::current().getNodesForPhysicalGroup(m_fDim, physTag, nodeTags);
+        std::sort(nodeTags.begin(), nodeTags.end());
 
-    screen_display::write_if_false(tmp == m_fNumNodes, "Bad dimension error...");
+#pragma omp parallel for schedule(static) num_threads(config.numThreads)
+        for (size_t k = 0; k < m_fBoundaryIds.size(); ++k)
+        {
+            int f = m_fBoundaryIds[k];
+            if (std::binary_search(nodeTags.begin(), nodeTags.end(), fNodeTag(f)))
+                m_fBC[f] = BCvalue;
+        }
+    }
 
-    //! TIMER END ///////////////////////////////////////////////////////////////////
-    auto end = std::chrono::system_clock::now();
-    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
-    screen_display::write_value("Elapsed time (getUniqueFaceNodeTags):", elapsed.count() * 1.0e-6, "s", BLUE);
-    //! //////////////////////////////////////////////////////////////////////////////
+    // Boundary faces grouped by BC type: reflecting faces first, then absorbing
+    auto reflectingEnd = std::stable_partition(m_fBoundaryIds.begin(), m_fBoundaryIds.end(),
+                                               [&](uint32_t f) { return m_fBC[f] == 1; });
+    m_fNumReflecting = reflectingEnd - m_fBoundaryIds.begin();
 }
 
-std::vector<size_t> vector_of_tags(size_t vec_size, size_t offset)
+/**
+ * Local time stepping: sort the interior faces and each group of boundary
+ * faces by level, the level of a face being the smallest level of its
+ * elements. The faces of the elements of level <= l are then the first ones
+ * of each list, so that the flux passes of a substep only visit them
+ * (precomputeFluxShared and updateFluxShared with maxLevel = l). The sorts
+ * are stable and keep the locality of the faces inside a level.
+ *
+ * @param elLevel level of each element
+ * @param numLevels number of levels
+ */
+void Mesh::setTimeLevels(std::vector<int> const &elLevel, int numLevels)
 {
-    std::vector<size_t> value;
-    // std::cout<<offset<<std::endl;
-    for (size_t i = 0, id = 0; i < vec_size; i++)
+    auto fLevel = [&](uint32_t f)
+    {
+        int level = elLevel[fNbrElId(f, 0)];
+        return m_fIsBoundary[f] ? level : std::min(level, elLevel[fNbrElId(f, 1)]);
+    };
+    auto byLevel = [&](uint32_t f1, uint32_t f2) { return fLevel(f1) < fLevel(f2); };
+    auto levelEnds = [&](std::vector<uint32_t>::iterator begin, std::vector<uint32_t>::iterator end)
     {
-        if (i % offset == 0)
-            id++;
-        value.push_back(id - 1);
-        // value.push_back((i % offset == 0)?(id++ - 1):id);
+        std::vector<int> ends(numLevels);
+        for (int l = 0; l < numLevels; ++l)
+            ends[l] = std::partition_point(begin, end, [&](uint32_t f) { return fLevel(f) <= l; }) - begin;
+        return ends;
+    };
+
+    std::stable_sort(m_fInteriorIds.begin(), m_fInteriorIds.end(), byLevel);
+    m_fInteriorLevelEnd = levelEnds(m_fInteriorIds.begin(), m_fInteriorIds.end());
+
+    const auto reflectingEnd = m_fBoundaryIds.begin() + m_fNumReflecting;
+    std::stable_sort(m_fBoundaryIds.begin(), reflectingEnd, byLevel);
+    m_fReflectingLevelEnd = levelEnds(m_fBoundaryIds.begin(), reflectingEnd);
+
+    // Absorbing faces: their R*K*R^-1 matrices follow the faces
+    const int numAbsorbing = m_fBoundaryIds.size() - m_fNumReflecting;
+    std::vector<int> order(numAbsorbing);
+    for (int a = 0; a < numAbsorbing; ++a)
+        order[a] = a;
+    std::stable_sort(order.begin(), order.end(), [&](int a1, int a2)
+                     { return byLevel(*(reflectingEnd + a1), *(reflectingEnd + a2)); });
+    std::vector<uint32_t> absorbingIds(numAbsorbing);
+    std::vector<double> rkr(RKR.size());
+    const size_t rkrSize = (size_t)m_fNumIntPts * 16;
+    for (int a = 0; a < numAbsorbing; ++a)
+    {
+        absorbingIds[a] = *(reflectingEnd + order[a]);
+        if (!RKR.empty())
+            std::copy(&RKR[order[a] * rkrSize], &RKR[order[a] * rkrSize] + rkrSize, &rkr[a * rkrSize]);
     }
-    return value;
+    std::copy(absorbingIds.begin(), absorbingIds.end(), reflectingEnd);
+    RKR.swap(rkr);
+    m_fAbsorbingLevelEnd = levelEnds(reflectingEnd, m_fBoundaryIds.end());
 }
-void Mesh::getConnectivityFaceToElement()
-{
-    //! TIMER start ////////////////////////////////
-    auto start = std::chrono::system_clock::now();
-    //! ////////////////////////////////////////////
-    m_fNbrElIds.resize(m_fNum);
-
-    std::vector<std::vector<size_t>> m_elFNodeTagsOrdered_tab = vector_to_matrix(m_elFNodeTagsOrdered, m_fNumNodes);
-    std::vector<std::vector<size_t>> m_fNodeTagsOrdered_tab = vector_to_matrix(m_fNodeTagsOrdered, m_fNumNodes);
-
-    std::vector<size_t> elFtags = vector_of_tags(m_elFNodeTagsOrdered_tab.size(), m_fNumPerEl); //! vector of elements face tags
-    std::vector<size_t> ftags = vector_of_tags(m_fNodeTagsOrdered_tab.size(), 1);               //! vector of face tags
 
-    for (size_t i = 0; i < m_elFNodeTagsOrdered_tab.size(); i++)
+/**
+ * Number of interior, reflecting and absorbing faces of level <= maxLevel
+ * (see setTimeLevels): all the faces if maxLevel < 0, or if the faces are
+ * not sorted by level, or if maxLevel is the last level.
+ */
+void Mesh::levelFaceCounts(int maxLevel, int &numInterior, int &numReflecting, int &numAbsorbing)
+{
+    if (maxLevel < 0 || maxLevel >= (int)m_fInteriorLevelEnd.size())
     {
-        for (size_t j = 0; j < m_fNodeTagsOrdered_tab.size(); j++)
-        {
-            if (isNCoincidentValues(m_elFNodeTagsOrdered_tab[i], m_fNodeTagsOrdered_tab[j], m_fNumNodes))
-            {
-                m_elFIds.push_back(ftags[j]);
-                m_fNbrElIds[ftags[j]].push_back(elFtags[i]);
-                if (m_fNbrElIds[ftags[j]].size() == 2)
-                {
-                    erase_row_from_matrix(m_fNodeTagsOrdered_tab, j);
-                    erase_row_from_vector(ftags, j);
-                    break;
-                }
-                // if(flag) break;
-            }
-        }
+        numInterior = m_fInteriorIds.size();
+        numReflecting = m_fNumReflecting;
+        numAbsorbing = m_fBoundaryIds.size() - m_fNumReflecting;
+        return;
     }
-
-    //! TIMER END ///////////////////////////////////////////////////////////////////
-    auto end = std::chrono::system_clock::now();
-    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
-    screen_display::write_value("Elapsed time (getConnectivityFaceToElement):", elapsed.count() * 1.0e-6, "s", BLUE);
-    //! //////////////////////////////////////////////////////////////////////////////
+    numInterior = m_fInteriorLevelEnd[maxLevel];
+    numReflecting = m_fReflectingLevelEnd[maxLevel];
+    numAbsorbing = m_fAbsorbingLevelEnd[maxLevel];
 }
 
 /**
  * @brief Write VTK & PVD
  */
 
-void Mesh::writeVTUb(std::string filename, std::vector<std::vector<double>> &u)
+void Mesh::writeVTUb(std::string filename, SolutionField &u)
 {
     // std::string filename = filename;
     screen_display::write_string("Write VTU: " + filename, BOLDRED);
 
-    size_t eltype;
-    std::vector<size_t> node_tag;
-    std::vector<double> coord_tmp;
-    std::vector<double> param_coord_tmp;
-    gmsh::model::mesh::getNodes(node_tag, coord_tmp, param_coord_tmp);
-    coord_tmp.clear();
-    param_coord_tmp.clear();
+    // Points are numbered by node tag (tags are contiguous and start from 1)
+    size_t numPoints = *std::max_element(m_elNodeTags.begin(), m_elNodeTags.end());
 
     size_t elNumNodes = (m_elDim == 2) ? 3 : 4; //! 3 points: triangle , 4 points : tetrahedral
 
@@ -1155,24 +1715,25 @@ void Mesh::writeVTUb(std::string filename, std::vector<std::vector<double>> &u)
     vtkNew<vtkUnstructuredGrid> unstructuredGrid;
     vtkNew<vtkXMLUnstructuredGridWriter> writer;
 
-    for (auto n : node_tag)
-    {
-        std::vector<double> coord, paramCoord;
-        int _dim, _tag;
-        gmsh::model::mesh::getNode(n, coord, paramCoord, _dim, _tag);
-        points->InsertNextPoint(coord[0], coord[1], coord[2]);
-    }
+    points->SetNumberOfPoints(numPoints);
+    for (size_t n = 0; n < m_elNodeTags.size(); ++n)
+        points->SetPoint(m_elNodeTags[n] - 1, m_nodeCoords[n * 3], m_nodeCoords[n * 3 + 1], m_nodeCoords[n * 3 + 2]);
+
+    // Cells are written in the order of the mesh file
+    auto fileElId = [&](size_t i)
+    { return m_elNewIds.empty() ? i : (size_t)m_elNewIds[i]; };
 
     for (size_t i = 0; i < getElNum(); i++)
     {
+        size_t el = fileElId(i);
         vtkNew<vtkTetra> tetra;
         vtkNew<vtkTriangle> tri;
         for (size_t j = 0; j < elNumNodes; j++) /*getElNumNodes()*/
         {
             if (m_elDim == 3)
-                tetra->GetPointIds()->SetId(j, elNodeTag(i, j) - 1);
+                tetra->GetPointIds()->SetId(j, elNodeTag(el, j) - 1);
             else
-                tri->GetPointIds()->SetId(j, elNodeTag(i, j) - 1);
+                tri->GetPointIds()->SetId(j, elNodeTag(el, j) - 1);
         }
 
         if (m_elDim == 3)
@@ -1186,15 +1747,16 @@ void Mesh::writeVTUb(std::string filename, std::vector<std::vector<double>> &u)
     velocity->SetName("Velocity [m/s]");
     velocity->SetNumberOfComponents(3);
 
-    std::vector<size_t> nb_occurence(node_tag.size(), 1);
-    std::vector<double> pressure_vec(node_tag.size(), 0.0);
-    std::vector<double> density_vec(node_tag.size(), 0.0);
-    std::vector<double> vel_x_vec(node_tag.size(), 0.0);
-    std::vector<double> vel_y_vec(node_tag.size(), 0.0);
-    std::vector<double> vel_z_vec(node_tag.size(), 0.0);
+    std::vector<size_t> nb_occurence(numPoints, 1);
+    std::vector<double> pressure_vec(numPoints, 0.0);
+    std::vector<double> density_vec(numPoints, 0.0);
+    std::vector<double> vel_x_vec(numPoints, 0.0);
+    std::vector<double> vel_y_vec(numPoints, 0.0);
+    std::vector<double> vel_z_vec(numPoints, 0.0);
 
-    for (size_t el = 0; el < getElNum(); ++el)
+    for (size_t i = 0; i < getElNum(); ++i)
     {
+        size_t el = fileElId(i);
         double p(0.0), rho(0.0), vx(0.0), vy(0.0), vz(0.0);
         for (size_t n = 0; n < getElNumNodes(); ++n)
         {
@@ -1229,22 +1791,23 @@ void Mesh::writeVTUb(std::string filename, std::vector<std::vector<double>> &u)
     writer->Write();
 }
 
-void Mesh::writePVD(std::string filename)
+/**
+ * Write the ParaView collection of the saved solutions.
+ *
+ * @param filename
+ * @param outputs step number and time of each saved solution (results/result<step>.vtu)
+ */
+void Mesh::writePVD(std::string filename, std::vector<std::pair<int, double>> const &outputs)
 {
     screen_display::write_string("Write PVD at " + filename, BOLDRED);
     std::ofstream file(filename.c_str(), std::ios_base::ate);
 
     file << "<VTKFile type=\"Collection\" version=\"1.0\" byte_order=\"LittleEndian\" header_type=\"UInt64\">" << std::endl;
     file << "  <Collection>" << std::endl;
-    for (double t = config.timeStart, step = 0, tDisplay = 0; t <= config.timeEnd;
-         t += config.timeStep, tDisplay += config.timeStep, ++step)
+    for (auto const &output : outputs)
     {
-        if (tDisplay >= config.timeRate || step == 0)
-        {
-            tDisplay = 0;
-            std::string vtu_filename = "results/result" + std::to_string((int)step) + ".vtu";
-            file << "    <DataSet timestep=\"" << t << "\" part=\"0\" file=\"" << vtu_filename << "\"/>" << std::endl;
-        }
+        std::string vtu_filename = "results/result" + std::to_string(output.first) + ".vtu";
+        file << "    <DataSet timestep=\"" << output.second << "\" part=\"0\" file=\"" << vtu_filename << "\"/>" << std::endl;
     }
     file << "  </Collection>" << std::endl;
     file << "</VTKFile>" << std::endl;
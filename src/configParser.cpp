@@ -1,7 +1,7 @@
 #include <algorithm>
+#include <cmath>
 #include <cstdio>
 #include <fstream>
-#include <gmsh.h>
 #include <iostream>
 #include <map>
 #include <sstream>
@@ -9,6 +9,7 @@
 #include <utils.h>
 
 #include "configParser.h"
+#include "meshCache.h"
 
 /**
  * Parse et load config file.
@@ -30,6 +31,41 @@ namespace config
         return internal;
     }
 
+    /**
+     * Check the sizes of the initial conditions (gaussian width, > 0) and the
+     * radii of the sources and observers (>= 0) before they select nodes.
+     */
+    void checkSizes(Config const &config)
+    {
+        for (int i = 0; i < config.initConditions.size(); ++i)
+        {
+            double size = config.initConditions[i][4];
+            if (!(size > 0) || !std::isfinite(size))
+            {
+                std::string message = "Initial condition " + std::to_string(i + 1) + ": size must be positive";
+                Fatal_Error(message.c_str())
+            }
+        }
+        for (int i = 0; i < config.sources.size(); ++i)
+        {
+            double radius = config.sources[i].source[4];
+            if (!(radius >= 0) || !std::isfinite(radius))
+            {
+                std::string message = "Source " + std::to_string(i + 1) + ": size must be positive or zero";
+                Fatal_Error(message.c_str())
+            }
+        }
+        for (int i = 0; i < config.observers.size(); ++i)
+        {
+            double radius = config.observers[i][3];
+            if (!(radius >= 0) || !std::isfinite(radius))
+            {
+                std::string message = "Observer " + std::to_string(i + 1) + ": size must be positive or zero";
+                Fatal_Error(message.c_str())
+            }
+        }
+    }
+
     Config parseConfig(std::string name)
     {
         Config config;
@@ -53,8 +89,15 @@ namespace config
             config.meshFileName = configMap["meshFileName"];
             config.timeStart = std::stod(configMap["timeStart"]);
             config.timeEnd = std::stod(configMap["timeEnd"]);
-            config.timeStep = std::stod(configMap["timeStep"]);
+            if (configMap["timeStep"] == "auto")
+                config.timeStepAuto = true;
+            else
+                config.timeStep = std::stod(configMap["timeStep"]);
             config.timeRate = std::stod(configMap["timeRate"]);
+            if (configMap.count("timeStepSafety"))
+                config.timeStepSafety = std::stod(configMap["timeStepSafety"]);
+            if (configMap.count("timeLevels"))
+                config.timeLevels = std::stoi(configMap["timeLevels"]);
             config.elementType = configMap["elementType"];
             config.timeIntMethod = configMap["timeIntMethod"];
             // config.saveFile = configMap["saveFile"];
@@ -65,6 +108,18 @@ namespace config
             config.v0[2] = std::stod(configMap["v0_z"]);
             config.rho0 = std::stod(configMap["rho0"]);
             config.c0 = std::stod(configMap["c0"]);
+            if (configMap.count("meshCache"))
+                config.meshCache = std::stoi(configMap["meshCache"]) != 0;
+            if (configMap.count("meshReordering"))
+                config.meshReordering = std::stoi(configMap["meshReordering"]) != 0;
+            if (configMap.count("elBlockSize"))
+                config.elBlockSize = std::stoi(configMap["elBlockSize"]);
+            if (configMap.count("simd"))
+                config.simd = configMap["simd"];
+            if (configMap.count("simdBenchmark"))
+                config.simdBenchmark = std::stoi(configMap["simdBenchmark"]) != 0;
+            if (configMap.count("fluxBenchmark"))
+                config.fluxBenchmark = std::stoi(configMap["fluxBenchmark"]) != 0;
 
             for (std::map<std::string, std::string>::iterator iter = configMap.begin(); iter != configMap.end(); ++iter)
             {
@@ -191,10 +246,11 @@ namespace config
             }
 
             std::string physName;
+            std::vector<std::pair<int, std::string>> physGroups;
             std::ifstream mFile(config.meshFileName);
             if (mFile.is_open())
             {
-                gmsh::open(config.meshFileName);
+                meshCache::getPhysicalGroups(config.meshFileName, config.meshCache, config.numThreads, physGroups);
             }
             else
             {
@@ -202,23 +258,20 @@ namespace config
                 Fatal_Error(message.c_str())
             }
             mFile.close();
-            gmsh::vectorpair m_physicalDimTags;
-            int bcDim = gmsh::model::getDimension() - 1;
-            gmsh::model::getPhysicalGroups(m_physicalDimTags, bcDim);
-            for (int p = 0; p < m_physicalDimTags.size(); ++p)
+            for (int p = 0; p < physGroups.size(); ++p)
             {
-                gmsh::model::getPhysicalName(m_physicalDimTags[p].first, m_physicalDimTags[p].second, physName);
+                physName = physGroups[p].second;
                 if (configMap[physName].find("Absorbing") == 0)
                 {
-                    config.physBCs[m_physicalDimTags[p].second] = std::make_pair("Absorbing", 0);
+                    config.physBCs[physGroups[p].first] = std::make_pair("Absorbing", 0);
                 }
                 else if (configMap[physName].find("Reflecting") == 0)
                 {
-                    config.physBCs[m_physicalDimTags[p].second] = std::make_pair("Reflecting", 0);
+                    config.physBCs[physGroups[p].first] = std::make_pair("Reflecting", 0);
                 }
                 else
                 {
-                    gmsh::logger::write("Not specified or supported boundary conditions.");
+                    screen_display::write_string("Not specified or supported boundary conditions.", RED);
                 }
             }
         }
@@ -228,15 +281,17 @@ namespace config
             Fatal_Error(message.c_str())
             // throw;
         }
-        gmsh::logger::write("==================================================");
-        gmsh::logger::write("Simulation parameters: ");
-        gmsh::logger::write("Time step: " + std::to_string(config.timeStep));
-        gmsh::logger::write("Final time: " + std::to_string(config.timeEnd));
-        gmsh::logger::write("Mean flow velocity: (" + std::to_string(config.v0[0]) + "," + std::to_string(config.v0[1]) + "," + std::to_string(config.v0[2]) + ")");
-        gmsh::logger::write("Mean density: " + std::to_string(config.rho0));
-        gmsh::logger::write("Speed of sound: " + std::to_string(config.c0));
-        gmsh::logger::write("Mesh file: " + config.meshFileName);
-        gmsh::logger::write("Solver: " + config.timeIntMethod);
+        checkSizes(config);
+
+        screen_display::write_string("==================================================");
+        screen_display::write_string("Simulation parameters: ");
+        screen_display::write_string("Time step: " + (config.timeStepAuto ? std::string("auto") : std::to_string(config.timeStep)));
+        screen_display::write_string("Final time: " + std::to_string(config.timeEnd));
+        screen_display::write_string("Mean flow velocity: (" + std::to_string(config.v0[0]) + "," + std::to_string(config.v0[1]) + "," + std::to_string(config.v0[2]) + ")");
+        screen_display::write_string("Mean density: " + std::to_string(config.rho0));
+        screen_display::write_string("Speed of sound: " + std::to_string(config.c0));
+        screen_display::write_string("Mesh file: " + config.meshFileName);
+        screen_display::write_string("Solver: " + config.timeIntMethod);
 
         return config;
     }
@@ -253,11 +308,19 @@ namespace config
             cFile >> config.jsonData;
             config.meshFileName = config.jsonData["mesh"]["File"];
             int nbBC = config.jsonData["mesh"]["BC"]["number"];
+            if (config.jsonData["mesh"].contains("cache"))
+                config.meshCache = config.jsonData["mesh"]["cache"];
+            if (config.jsonData["mesh"].contains("reordering"))
+                config.meshReordering = config.jsonData["mesh"]["reordering"];
+            // Also used to read the mesh
+            config.numThreads = config.jsonData["solver"]["numThreads"];
+            config.numThreads = (config.numThreads == 1) ? 0 : config.numThreads;
             std::string physName;
+            std::vector<std::pair<int, std::string>> physGroups;
             std::ifstream mFile(config.meshFileName);
             if (mFile.is_open())
             {
-                gmsh::open(config.meshFileName);
+                meshCache::getPhysicalGroups(config.meshFileName, config.meshCache, config.numThreads, physGroups);
             }
             else
             {
@@ -265,26 +328,23 @@ namespace config
                 Fatal_Error(message.c_str())
             }
             mFile.close();
-            gmsh::vectorpair m_physicalDimTags;
-            int bcDim = gmsh::model::getDimension() - 1;
-            gmsh::model::getPhysicalGroups(m_physicalDimTags, bcDim);
-            for (int p = 0; p < m_physicalDimTags.size(); ++p)
+            for (int p = 0; p < physGroups.size(); ++p)
             {
-                gmsh::model::getPhysicalName(m_physicalDimTags[p].first, m_physicalDimTags[p].second, physName);
+                physName = physGroups[p].second;
                 if (physName == config.jsonData["mesh"]["BC"]["boundary" + std::to_string(p + 1)]["name"])
                 {
                     if (config.jsonData["mesh"]["BC"]["boundary" + std::to_string(p + 1)]["type"] == "Absorbing")
-                        config.physBCs[m_physicalDimTags[p].second] = std::make_pair("Absorbing", 0);
+                        config.physBCs[physGroups[p].first] = std::make_pair("Absorbing", 0);
                     else if (config.jsonData["mesh"]["BC"]["boundary" + std::to_string(p + 1)]["type"] == "Reflecting")
-                        config.physBCs[m_physicalDimTags[p].second] = std::make_pair("Reflecting", 0);
+                        config.physBCs[physGroups[p].first] = std::make_pair("Reflecting", 0);
                     else
                     {
-                        gmsh::logger::write("Not specified or supported boundary conditions.");
+                        screen_display::write_string("Not specified or supported boundary conditions.", RED);
                     }
                 }
                 else
                 {
-                    gmsh::logger::write("Not specified or supported boundary conditions.");
+                    screen_display::write_string("Not specified or supported boundary conditions.", RED);
                 }
             }
             screen_display::write_string("Mesh loaded", GREEN);
@@ -292,12 +352,25 @@ namespace config
 
             config.timeStart = config.jsonData["solver"]["time"]["start"];
             config.timeEnd = config.jsonData["solver"]["time"]["end"];
-            config.timeStep = config.jsonData["solver"]["time"]["step"];
+            if (config.jsonData["solver"]["time"]["step"] == "auto")
+                config.timeStepAuto = true;
+            else
+                config.timeStep = config.jsonData["solver"]["time"]["step"];
             config.timeRate = config.jsonData["solver"]["time"]["rate"];
+            if (config.jsonData["solver"]["time"].contains("safety"))
+                config.timeStepSafety = config.jsonData["solver"]["time"]["safety"];
+            if (config.jsonData["solver"]["time"].contains("levels"))
+                config.timeLevels = config.jsonData["solver"]["time"]["levels"];
             config.elementType = config.jsonData["solver"]["elementType"];
             config.timeIntMethod = config.jsonData["solver"]["timeIntMethod"];
-            config.numThreads = config.jsonData["solver"]["numThreads"];
-            config.numThreads = (config.numThreads == 1) ? 0 : config.numThreads;
+            if (config.jsonData["solver"].contains("blockSize"))
+                config.elBlockSize = config.jsonData["solver"]["blockSize"];
+            if (config.jsonData["solver"].contains("simd"))
+                config.simd = config.jsonData["solver"]["simd"];
+            if (config.jsonData["solver"].contains("simdBenchmark"))
+                config.simdBenchmark = config.jsonData["solver"]["simdBenchmark"];
+            if (config.jsonData["solver"].contains("fluxBenchmark"))
+                config.fluxBenchmark = config.jsonData["solver"]["fluxBenchmark"];
             screen_display::write_string("Solver parameters loaded", GREEN);
             // initial conditions
             config.v0[0] = config.jsonData["initialization"]["meanFlow"]["vx"];
@@ -436,15 +509,17 @@ namespace config
             Fatal_Error(message.c_str())
             // throw;
         }
-        gmsh::logger::write("==================================================");
-        gmsh::logger::write("Simulation parameters: ");
-        gmsh::logger::write("Time step: " + std::to_string(config.timeStep));
-        gmsh::logger::write("Final time: " + std::to_string(config.timeEnd));
-        gmsh::logger::write("Mean flow velocity: (" + std::to_string(config.v0[0]) + "," + std::to_string(config.v0[1]) + "," + std::to_string(config.v0[2]) + ")");
-        gmsh::logger::write("Mean density: " + std::to_string(config.rho0));
-        gmsh::logger::write("Speed of sound: " + std::to_string(config.c0));
-        gmsh::logger::write("Mesh file: " + config.meshFileName);
-        gmsh::logger::write("Solver: " + config.timeIntMethod);
+        checkSizes(config);
+
+        screen_display::write_string("==================================================");
+        screen_display::write_string("Simulation parameters: ");
+        screen_display::write_string("Time step: " + (config.timeStepAuto ? std::string("auto") : std::to_string(config.timeStep)));
+        screen_display::write_string("Final time: " + std::to_string(config.timeEnd));
+        screen_display::write_string("Mean flow velocity: (" + std::to_string(config.v0[0]) + "," + std::to_string(config.v0[1]) + "," + std::to_string(config.v0[2]) + ")");
+        screen_display::write_string("Mean density: " + std::to_string(config.rho0));
+        screen_display::write_string("Speed of sound: " + std::to_string(config.c0));
+        screen_display::write_string("Mesh file: " + config.meshFileName);
+        screen_display::write_string("Solver: " + config.timeIntMethod);
 
         return config;
     }
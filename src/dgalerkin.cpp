@@ -1,7 +1,7 @@
 #include <cstdio>
 #include <errno.h>
-#include <gmsh.h>
 #include <iostream>
+#include <limits>
 #include <omp.h>
 
 #include <parallel/algorithm>
@@ -9,6 +9,7 @@
 
 #include "Mesh.h"
 #include "configParser.h"
+#include "meshModel.h"
 #include "solver.h"
 
 int main(int argc, char **argv)
@@ -31,9 +32,6 @@ int main(int argc, char **argv)
     }
     std::string config_name = argv[1];
 
-    gmsh::initialize();
-    gmsh::option::setNumber("General.Terminal", 1.0);
-
     Config config;
 
     if (fileExtension(config_name) == "conf")
@@ -41,14 +39,19 @@ int main(int argc, char **argv)
     if (fileExtension(config_name) == "json")
         config = config::parseJSON(config_name);    
 
-    gmsh::logger::write("Config loaded : " + config_name);
+    screen_display::write_string("Config loaded : " + config_name);
 
     Mesh mesh(config);
+    if (config.timeStepAuto)
+        config.timeStep = solver::autoTimeStep(mesh, config);
 
     /**
      * Initialize the solution:
+     * The gaussian is only evaluated where it is not negligible compared
+     * to its amplitude, i.e. exp(-r^2/size) > machine epsilon.
      */
-    std::vector<std::vector<double>> u(4, std::vector<double>(mesh.getNumNodes(), 0));
+    SolutionField u(4, mesh.getElNum(), mesh.getElNumNodes(), config.numThreads);
+    std::vector<size_t> nodeIds;
     for (int i = 0; i < config.initConditions.size(); ++i)
     {
         double x = config.initConditions[i][1];
@@ -56,12 +59,13 @@ int main(int argc, char **argv)
         double z = config.initConditions[i][3];
         double size = config.initConditions[i][4];
         double amp = config.initConditions[i][5];
+        double radius = sqrt(-size * log(std::numeric_limits<double>::epsilon()));
 
-        for (int n = 0; n < mesh.getNumNodes(); n++)
+        std::vector<double> const &coords = mesh.getNodeCoords();
+        mesh.getSpatialIndex().radiusSearch(&config.initConditions[i][1], radius, nodeIds);
+        for (size_t n : nodeIds)
         {
-            std::vector<double> coord, paramCoord;
-            int _dim, _tag;
-            gmsh::model::mesh::getNode(mesh.getElNodeTags()[n], coord, paramCoord, _dim, _tag);
+            const double *coord = &coords[n * 3];
             u[0][n] += amp * exp(-((coord[0] - x) * (coord[0] - x) +
                                    (coord[1] - y) * (coord[1] - y) +
                                    (coord[2] - z) * (coord[2] - z)) /
@@ -69,6 +73,11 @@ int main(int argc, char **argv)
         }
     }
 
+    if (config.simdBenchmark)
+        solver::benchmarkKernels(u, mesh, config);
+    if (config.fluxBenchmark)
+        solver::benchmarkFaceFlux(u, mesh, config);
+
     /**
      * Start solver
      */
@@ -76,10 +85,13 @@ int main(int argc, char **argv)
         solver::forwardEuler(u, mesh, config);
     else if (config.timeIntMethod == "Runge-Kutta")
         solver::rungeKutta(u, mesh, config);
+    else if (solver::isLowStorageRK(config.timeIntMethod))
+        solver::lowStorageRungeKutta(u, mesh, config);
+    else if (solver::isLocalTimeStepping(config.timeIntMethod))
+        solver::localTimeStepping(u, mesh, config);
     else Fatal_Error("Time integration method error")    
 
-    mesh.writePVD("results.pvd");
-    gmsh::finalize();
+    meshModel::close();
 
     return EXIT_SUCCESS;
 }
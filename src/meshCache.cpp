@@ -0,0 +1,382 @@
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <map>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Mesh.h"
+#include "meshCache.h"
+#include "meshModel.h"
+#include "utils.h"
+
+namespace meshCache
+{
+    const char magic[8] = {'D', 'G', 'M', 'C', 'A', 'C', 'H', 'E'};
+    const uint32_t byteOrder = 0x01020304;
+
+    const uint64_t fnvOffset = 14695981039346656037ULL;
+    const uint64_t fnvPrime = 1099511628211ULL;
+
+    uint64_t fnv1a(const void *data, size_t size, uint64_t hash = fnvOffset)
+    {
+        const unsigned char *p = static_cast<const unsigned char *>(data);
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash ^= p[i];
+            hash *= fnvPrime;
+        }
+        return hash;
+    }
+
+    std::string fileName(std::string meshFileName)
+    {
+        return meshFileName + ".dgcache";
+    }
+
+    uint64_t hashFile(std::string fileName)
+    {
+        // The mesh file is hashed by the config parser and by the Mesh
+        // constructor: keep the result instead of reading the file twice.
+        static std::map<std::string, uint64_t> hashes;
+        if (hashes.count(fileName))
+            return hashes[fileName];
+
+        int fd = open(fileName.c_str(), O_RDONLY);
+        if (fd < 0)
+            return 0;
+        struct stat st;
+        uint64_t hash = 0;
+        if (fstat(fd, &st) == 0)
+        {
+            hash = fnvOffset;
+            if (st.st_size > 0)
+            {
+                void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (data != MAP_FAILED)
+                {
+                    madvise(data, st.st_size, MADV_SEQUENTIAL);
+                    hash = fnv1a(data, st.st_size);
+                    munmap(data, st.st_size);
+                }
+                else
+                {
+                    hash = 0;
+                }
+            }
+        }
+        close(fd);
+        if (hash != 0)
+            hashes[fileName] = hash;
+        return hash;
+    }
+
+    uint64_t hashConfig(Config const &config)
+    {
+        uint64_t hash = fnv1a(config.elementType.data(), config.elementType.size());
+        hash = fnv1a(config.v0.data(), config.v0.size() * sizeof(double), hash);
+        hash = fnv1a(&config.rho0, sizeof(double), hash);
+        hash = fnv1a(&config.c0, sizeof(double), hash);
+        hash = fnv1a(&config.meshReordering, sizeof(bool), hash);
+        for (auto const &bc : config.physBCs)
+        {
+            hash = fnv1a(&bc.first, sizeof(int), hash);
+            hash = fnv1a(bc.second.first.data(), bc.second.first.size(), hash);
+            hash = fnv1a(&bc.second.second, sizeof(double), hash);
+        }
+        return hash;
+    }
+
+    /**
+     * Read the cache header and the physical groups.
+     *
+     * @return true if the cache matches the mesh file content
+     */
+    bool readHeader(Reader &reader, uint64_t meshHash, uint64_t &configHash,
+                    std::vector<std::pair<int, std::string>> &physGroups)
+    {
+        const char *m = reader.readRaw(sizeof(magic));
+        uint32_t fileVersion = 0, fileByteOrder = 0, sizeOfSizeT = 0;
+        uint64_t fileMeshHash = 0;
+        reader.read(fileVersion);
+        reader.read(fileByteOrder);
+        reader.read(sizeOfSizeT);
+        reader.read(fileMeshHash);
+        reader.read(configHash);
+        if (!reader.good() || std::memcmp(m, magic, sizeof(magic)) != 0 ||
+            fileVersion != version || fileByteOrder != byteOrder ||
+            sizeOfSizeT != sizeof(size_t) || fileMeshHash != meshHash || meshHash == 0)
+            return false;
+
+        uint64_t numGroups = 0;
+        reader.read(numGroups);
+        physGroups.resize(reader.good() ? numGroups : 0);
+        for (size_t p = 0; p < physGroups.size() && reader.good(); ++p)
+        {
+            reader.read(physGroups[p].first);
+            reader.read(physGroups[p].second);
+        }
+        return reader.good();
+    }
+
+    void getPhysicalGroups(std::string meshFileName, bool useCache, int numThreads,
+                           std::vector<std::pair<int, std::string>> &physGroups)
+    {
+        physGroups.clear();
+        if (useCache)
+        {
+            Reader reader(fileName(meshFileName));
+            uint64_t configHash;
+            if (reader.good() && readHeader(reader, hashFile(meshFileName), configHash, physGroups))
+                return;
+            physGroups.clear();
+        }
+
+        meshModel::open(meshFileName, numThreads);
+        MeshModel &model = meshModel::current();
+        model.getPhysicalGroups(physGroups, model.getDimension() - 1);
+    }
+
+    /**
+     * Writer
+     */
+    Writer::Writer(std::string fileName)
+    {
+        m_file = fopen(fileName.c_str(), "wb");
+    }
+
+    Writer::~Writer()
+    {
+        if (m_file)
+            fclose(m_file);
+    }
+
+    void Writer::writeRaw(const void *data, size_t size)
+    {
+        static const char padding[8] = {0};
+        if (!good())
+            return;
+        if (size > 0 && fwrite(data, 1, size, m_file) != size)
+            m_error = true;
+        size_t pad = (8 - size % 8) % 8;
+        if (pad > 0 && fwrite(padding, 1, pad, m_file) != pad)
+            m_error = true;
+    }
+
+    void Writer::write(std::vector<bool> const &v)
+    {
+        write(std::vector<char>(v.begin(), v.end()));
+    }
+
+    void Writer::write(std::string const &s)
+    {
+        write(std::vector<char>(s.begin(), s.end()));
+    }
+
+    /**
+     * Reader
+     */
+    Reader::Reader(std::string fileName)
+    {
+        int fd = open(fileName.c_str(), O_RDONLY);
+        if (fd < 0)
+            return;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0)
+        {
+            void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED)
+            {
+                madvise(data, st.st_size, MADV_SEQUENTIAL);
+                m_data = static_cast<const char *>(data);
+                m_size = st.st_size;
+            }
+        }
+        close(fd);
+    }
+
+    Reader::~Reader()
+    {
+        if (m_data)
+            munmap(const_cast<char *>(m_data), m_size);
+    }
+
+    const char *Reader::readRaw(size_t size)
+    {
+        size_t padded = size + (8 - size % 8) % 8;
+        if (!good() || padded > m_size - m_pos)
+        {
+            m_error = true;
+            return nullptr;
+        }
+        const char *p = m_data + m_pos;
+        m_pos += padded;
+        return p;
+    }
+
+    void Reader::read(std::vector<bool> &v)
+    {
+        std::vector<char> c;
+        read(c);
+        v.assign(c.begin(), c.end());
+    }
+
+    void Reader::read(std::string &s)
+    {
+        std::vector<char> c;
+        read(c);
+        s.assign(c.begin(), c.end());
+    }
+}
+
+/**
+ * The whole preprocessed state goes through this single function, so that
+ * the writing and the reading of the cache cannot get out of sync.
+ * Gmsh tags (m_elType, m_fType, m_fEntity) are kept for information only.
+ */
+template <typename Stream>
+void Mesh::serialize(Stream &s)
+{
+    // Elements
+    s.io(fc);
+    s.io(m_elDim);
+    s.io(m_elType);
+    s.io(m_elName);
+    s.io(m_elOrder);
+    s.io(m_elNumNodes);
+    s.io(m_elNumPrimaryNodes);
+    s.io(m_elNumIntPts);
+    s.io(m_elNum);
+    s.io(m_elIntType);
+    s.io(m_elParamCoord);
+    s.io(m_elTags);
+    s.io(m_elNodeTags);
+    s.io(m_nodeCoords);
+    s.io(m_elJacobianDets);
+    s.io(m_elCurvedJacobianDets);
+    s.io(m_elInvJacobians);
+    s.io(m_elCurvedIds);
+    s.io(m_elIntParamCoords);
+    s.io(m_elBasisFcts);
+    s.io(m_elUGradBasisFcts);
+    s.io(m_elGradBasisFcts);
+    s.io(m_elFIds);
+    s.io(m_elFNodeTags);
+    s.io(m_elFNodeTagsOrdered);
+    s.io(m_elFOrientation);
+    s.io(m_elWeight);
+    s.io(m_elNewIds);
+
+    // Faces
+    s.io(m_fDim);
+    s.io(m_fName);
+    s.io(m_fType);
+    s.io(m_fNumNodes);
+    s.io(m_fNumPerEl);
+    s.io(m_fEntity);
+    s.io(m_fNum);
+    s.io(m_fNumIntPts);
+    s.io(m_fIntType);
+    s.io(m_fNodeTags);
+    s.io(m_fNodeTagsOrdered);
+    s.io(m_fTags);
+    s.io(m_fJacobians);
+    s.io(m_fJacobianDets);
+    s.io(m_fIntPtCoords);
+    s.io(m_fIntParamCoords);
+    s.io(m_fBasisFcts);
+    s.io(m_fUGradBasisFcts);
+    s.io(m_fGradBasisFcts);
+    s.io(m_fNormals);
+    s.io(m_fTangents);
+    s.io(m_fBiTangents);
+    s.io(m_fNbrElIds);
+    s.io(m_fNToElNIds);
+    s.io(m_fInteriorIds);
+    s.io(m_fBoundaryIds);
+    s.io(m_fNumReflecting);
+    s.io(m_fIsBoundary);
+    s.io(m_fBC);
+    s.io(m_fWeight);
+
+    // Precomputed operators
+    s.io(m_refMassMatrix);
+    s.io(m_elRefDiffMatrices);
+    s.io(m_fLiftMatrix);
+    s.io(m_elMassMatrices);
+    s.io(RKR);
+}
+
+/**
+ * Load the preprocessed mesh from the cache file.
+ *
+ * @param fileName Cache file name
+ * @return true if the cache file matches the mesh file and the configuration
+ */
+bool Mesh::loadCache(std::string fileName)
+{
+    meshCache::Reader reader(fileName);
+    if (!reader.good())
+        return false;
+
+    uint64_t configHash;
+    std::vector<std::pair<int, std::string>> physGroups;
+    if (!meshCache::readHeader(reader, meshCache::hashFile(config.meshFileName), configHash, physGroups) ||
+        configHash != meshCache::hashConfig(config))
+        return false;
+
+    serialize(reader);
+    if (!reader.good())
+    {
+        screen_display::write_string("Corrupted mesh cache " + fileName + ", rebuilding it", RED);
+        return false;
+    }
+
+    m_spatialIndex.build(m_nodeCoords, m_elNumNodes, m_elNumPrimaryNodes, m_elDim);
+    return true;
+}
+
+/**
+ * Write the preprocessed mesh to the cache file. The file is written under
+ * a temporary name and renamed, so that concurrent runs never read a
+ * partially written cache.
+ *
+ * @param fileName Cache file name
+ */
+void Mesh::saveCache(std::string fileName)
+{
+    uint64_t meshHash = meshCache::hashFile(config.meshFileName);
+    if (meshHash == 0)
+        return;
+
+    std::vector<std::pair<int, std::string>> physGroups;
+    meshModel::current().getPhysicalGroups(physGroups, m_elDim - 1);
+
+    std::string tmpFileName = fileName + "." + std::to_string(getpid());
+    {
+        meshCache::Writer writer(tmpFileName);
+        writer.writeRaw(meshCache::magic, sizeof(meshCache::magic));
+        writer.write(meshCache::version);
+        writer.write(meshCache::byteOrder);
+        writer.write((uint32_t)sizeof(size_t));
+        writer.write(meshHash);
+        writer.write(meshCache::hashConfig(config));
+        writer.write((uint64_t)physGroups.size());
+        for (size_t p = 0; p < physGroups.size(); ++p)
+        {
+            writer.write(physGroups[p].first);
+            writer.write(physGroups[p].second);
+        }
+        serialize(writer);
+
+        if (!writer.good())
+        {
+            screen_display::write_string("Unable to write the mesh cache " + fileName, RED);
+            std::remove(tmpFileName.c_str());
+            return;
+        }
+    }
+    if (std::rename(tmpFileName.c_str(), fileName.c_str()) != 0)
+        std::remove(tmpFileName.c_str());
+}
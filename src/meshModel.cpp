@@ -0,0 +1,163 @@
+#include <chrono>
+#include <memory>
+#ifdef DGALERKIN_WITH_GMSH
+#include <gmsh.h>
+#endif
+
+#include "meshModel.h"
+#include "mshReader.h"
+#include "utils.h"
+
+#ifdef DGALERKIN_WITH_GMSH
+int GmshModel::getDimension()
+{
+    return gmsh::model::getDimension();
+}
+
+void GmshModel::getPhysicalGroups(std::vector<std::pair<int, std::string>> &physGroups, int dim)
+{
+    std::string physName;
+    gmsh::vectorpair physDimTags;
+    gmsh::model::getPhysicalGroups(physDimTags, dim);
+    physGroups.clear();
+    for (int p = 0; p < physDimTags.size(); ++p)
+    {
+        gmsh::model::getPhysicalName(physDimTags[p].first, physDimTags[p].second, physName);
+        physGroups.push_back(std::make_pair(physDimTags[p].second, physName));
+    }
+}
+
+void GmshModel::getNodesForPhysicalGroup(int dim, int tag, std::vector<size_t> &nodeTags)
+{
+    std::vector<double> coord;
+    gmsh::model::mesh::getNodesForPhysicalGroup(dim, tag, nodeTags, coord);
+}
+
+void GmshModel::getNodes(std::vector<size_t> &nodeTags, std::vector<double> &coord)
+{
+    std::vector<double> parametricCoord;
+    gmsh::model::mesh::getNodes(nodeTags, coord, parametricCoord, -1, -1, false, false);
+}
+
+void GmshModel::getElementTypes(std::vector<int> &elementTypes, int dim)
+{
+    gmsh::model::mesh::getElementTypes(elementTypes, dim);
+}
+
+int GmshModel::getElementType(std::string familyName, int order)
+{
+    return gmsh::model::mesh::getElementType(familyName, order);
+}
+
+void GmshModel::getElementProperties(int elementType, std::string &elementName, int &dim, int &order, int &numNodes,
+                                     std::vector<double> &localNodeCoord, int &numPrimaryNodes)
+{
+    gmsh::model::mesh::getElementProperties(elementType, elementName, dim, order, numNodes,
+                                            localNodeCoord, numPrimaryNodes);
+}
+
+void GmshModel::getElementsByType(int elementType, std::vector<size_t> &elementTags, std::vector<size_t> &nodeTags)
+{
+    gmsh::model::mesh::getElementsByType(elementType, elementTags, nodeTags);
+}
+
+void GmshModel::getElementEdgeNodes(int elementType, std::vector<size_t> &nodeTags)
+{
+    gmsh::model::mesh::getElementEdgeNodes(elementType, nodeTags, -1);
+}
+
+void GmshModel::getElementFaceNodes(int elementType, int faceType, std::vector<size_t> &nodeTags)
+{
+    gmsh::model::mesh::getElementFaceNodes(elementType, faceType, nodeTags, -1);
+}
+
+void GmshModel::getBarycenters(int elementType, std::vector<double> &barycenters)
+{
+    gmsh::model::mesh::getBarycenters(elementType, -1, false, true, barycenters);
+}
+
+void GmshModel::getIntegrationPoints(int elementType, std::string integrationType,
+                                     std::vector<double> &localCoord, std::vector<double> &weights)
+{
+    gmsh::model::mesh::getIntegrationPoints(elementType, integrationType, localCoord, weights);
+}
+
+void GmshModel::getBasisFunctions(int elementType, std::vector<double> const &localCoord, std::string functionSpaceType,
+                                  std::vector<double> &basisFunctions)
+{
+    int numComponents, numOrientations;
+    gmsh::model::mesh::getBasisFunctions(elementType, localCoord, functionSpaceType,
+                                         numComponents, basisFunctions, numOrientations);
+}
+
+void GmshModel::getJacobians(int elementType, std::vector<double> const &localCoord, std::vector<double> &jacobians,
+                             std::vector<double> &determinants, std::vector<double> &coord, int tag)
+{
+    gmsh::model::mesh::getJacobians(elementType, localCoord, jacobians, determinants, coord, tag);
+}
+
+int GmshModel::addElements(int dim, int elementType, std::vector<size_t> const &nodeTags)
+{
+    int entity = gmsh::model::addDiscreteEntity(dim);
+    gmsh::model::mesh::addElementsByType(entity, elementType, {}, nodeTags);
+    return entity;
+}
+#endif // DGALERKIN_WITH_GMSH
+
+namespace meshModel
+{
+    std::unique_ptr<MeshModel> model;
+    bool gmshInitialized = false;
+
+    void open(std::string fileName, int numThreads)
+    {
+        auto start = std::chrono::system_clock::now();
+        std::unique_ptr<MshModel> mshModel(new MshModel());
+        if (mshModel->read(fileName, numThreads))
+        {
+            model = std::move(mshModel);
+            screen_display::write_string("Mesh file read natively: " + fileName);
+        }
+        else
+        {
+#ifdef DGALERKIN_WITH_GMSH
+            if (!gmshInitialized)
+            {
+                gmsh::initialize();
+                gmsh::option::setNumber("General.Terminal", 1.0);
+                gmshInitialized = true;
+            }
+            gmsh::open(fileName);
+            model.reset(new GmshModel());
+#else
+            std::string message = "Mesh file '" + fileName + "' is not a supported MSH 4.1 mesh, rebuild with WITH_GMSH to read it";
+            Fatal_Error(message.c_str())
+#endif
+        }
+        auto end = std::chrono::system_clock::now();
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
+        screen_display::write_value("Mesh file loading time:", elapsed.count() * 1.0e-6, "s", BLUE);
+    }
+
+    bool isOpen()
+    {
+        return model != nullptr;
+    }
+
+    void close()
+    {
+        model.reset();
+#ifdef DGALERKIN_WITH_GMSH
+        if (gmshInitialized)
+            gmsh::finalize();
+        gmshInitialized = false;
+#endif
+    }
+
+    MeshModel &current()
+    {
+        if (!model)
+            Fatal_Error("No mesh opened")
+        return *model;
+    }
+}
@@ -0,0 +1,709 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <omp.h>
+#include <set>
+#include <sstream>
+
+#include "mshReader.h"
+#include "referenceElement.h"
+#include "utils.h"
+
+/**
+ * Cursor over the content of the mesh file. Section headers and physical
+ * names are always ASCII, the other records are ASCII or binary depending
+ * on the file type. The buffer is null terminated, so that strtod & co
+ * cannot read past its end.
+ */
+class MshModel::Parser
+{
+public:
+    Parser(std::vector<char> const &buffer) : m_p(buffer.data()), m_end(buffer.data() + buffer.size() - 1) {}
+
+    bool binary = false;
+    bool good() { return !m_error; }
+    void fail() { m_error = true; }
+
+    /**
+     * Move to the next "$Section" line and return the section name.
+     */
+    bool nextSection(std::string &name)
+    {
+        while (m_p < m_end && isspace(*m_p))
+            ++m_p;
+        if (m_p >= m_end || *m_p != '$')
+            return false;
+        name = line().substr(1);
+        while (!name.empty() && isspace(name.back()))
+            name.pop_back();
+        return true;
+    }
+
+    /**
+     * Move after the "$EndSection" line.
+     */
+    void endSection(std::string name)
+    {
+        std::string end = "$End" + name;
+        const char *p = (const char *)memmem(m_p, m_end - m_p, end.data(), end.size());
+        if (!p)
+        {
+            m_error = true;
+            m_p = m_end;
+            return;
+        }
+        m_p = p;
+        line();
+    }
+
+    /**
+     * Rest of the current line (ASCII).
+     */
+    std::string line()
+    {
+        const char *eol = (const char *)memchr(m_p, '\n', m_end - m_p);
+        if (!eol)
+            eol = m_end;
+        std::string l(m_p, eol);
+        m_p = (eol < m_end) ? eol + 1 : m_end;
+        return l;
+    }
+
+    template <typename T>
+    T value()
+    {
+        T v = 0;
+        if (binary)
+        {
+            if (m_end - m_p < (long)sizeof(T))
+            {
+                m_error = true;
+                return v;
+            }
+            std::memcpy(&v, m_p, sizeof(T));
+            m_p += sizeof(T);
+        }
+        else
+        {
+            char *e;
+            v = parse<T>(m_p, &e);
+            if (e == m_p)
+                m_error = true;
+            m_p = e;
+        }
+        return v;
+    }
+
+    /**
+     * ASCII: locate the beginning of the n next lines.
+     * Binary: return the beginning of the next n records of the given size.
+     */
+    void records(size_t n, size_t recordSize, std::vector<const char *> &starts)
+    {
+        starts.resize(n);
+        for (size_t i = 0; i < n && !m_error; ++i)
+        {
+            if (binary)
+            {
+                if ((size_t)(m_end - m_p) < recordSize)
+                {
+                    m_error = true;
+                    break;
+                }
+                starts[i] = m_p;
+                m_p += recordSize;
+            }
+            else
+            {
+                while (m_p < m_end && isspace(*m_p))
+                    ++m_p;
+                if (m_p >= m_end)
+                {
+                    m_error = true;
+                    break;
+                }
+                starts[i] = m_p;
+                const char *eol = (const char *)memchr(m_p, '\n', m_end - m_p);
+                m_p = eol ? eol + 1 : m_end;
+            }
+        }
+    }
+
+    /**
+     * Read a value at a given position (used by the parallel block parsing).
+     */
+    template <typename T>
+    T valueAt(const char *&p, bool &error)
+    {
+        T v = 0;
+        if (binary)
+        {
+            std::memcpy(&v, p, sizeof(T));
+            p += sizeof(T);
+        }
+        else
+        {
+            char *e;
+            v = parse<T>(p, &e);
+            if (e == p)
+                error = true;
+            p = e;
+        }
+        return v;
+    }
+
+private:
+    template <typename T>
+    static T parse(const char *p, char **e);
+
+    const char *m_p;
+    const char *m_end;
+    bool m_error = false;
+};
+
+template <>
+int MshModel::Parser::parse<int>(const char *p, char **e) { return (int)strtol(p, e, 10); }
+template <>
+size_t MshModel::Parser::parse<size_t>(const char *p, char **e) { return (size_t)strtoull(p, e, 10); }
+template <>
+double MshModel::Parser::parse<double>(const char *p, char **e) { return strtod(p, e); }
+
+bool MshModel::read(std::string fileName, int numThreads)
+{
+    m_numThreads = numThreads;
+
+    FILE *file = fopen(fileName.c_str(), "rb");
+    if (!file)
+        return false;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    std::vector<char> buffer(size > 0 ? size + 1 : 1, '\0');
+    bool ok = size > 0 && fread(buffer.data(), 1, size, file) == (size_t)size;
+    fclose(file);
+    if (!ok)
+        return false;
+
+    Parser parser(buffer);
+    std::string section;
+
+    /**
+     * [1] Format: only MSH 4.1 with 8 bytes size_t and native endianness
+     */
+    if (!parser.nextSection(section) || section != "MeshFormat")
+        return false;
+    std::string version, fileType, dataSize;
+    std::stringstream(parser.line()) >> version >> fileType >> dataSize;
+    if (version != "4.1" || dataSize != "8" || sizeof(size_t) != 8)
+        return false;
+    parser.binary = (fileType == "1");
+    if (parser.binary)
+    {
+        if (parser.value<int>() != 1)
+            return false;
+    }
+    parser.endSection(section);
+
+    /**
+     * [2] Sections
+     */
+    while (parser.good() && parser.nextSection(section))
+    {
+        if (section == "PhysicalNames")
+        {
+            int numNames = std::stoi(parser.line());
+            for (int i = 0; i < numNames; ++i)
+            {
+                std::string l = parser.line();
+                int dim, tag;
+                std::stringstream ss(l);
+                ss >> dim >> tag;
+                size_t q0 = l.find('"'), q1 = l.rfind('"');
+                std::string name = (q0 != std::string::npos && q1 > q0) ? l.substr(q0 + 1, q1 - q0 - 1) : "";
+                m_physNames[std::make_pair(dim, tag)] = name;
+            }
+        }
+        else if (section == "Entities")
+        {
+            if (!readEntities(parser))
+                return false;
+        }
+        else if (section == "Nodes")
+        {
+            if (!readNodes(parser))
+                return false;
+        }
+        else if (section == "Elements")
+        {
+            if (!readElements(parser))
+                return false;
+        }
+        else if (section == "PartitionedEntities")
+        {
+            return false; // Partitioned meshes are left to Gmsh
+        }
+        parser.endSection(section);
+    }
+
+    if (!parser.good() || m_blocks.empty() || m_nodeTags.empty())
+        return false;
+
+    for (auto const &b : m_blocks)
+        m_dim = std::max(m_dim, b.dim);
+    return true;
+}
+
+bool MshModel::readEntities(Parser &parser)
+{
+    size_t num[4];
+    for (int d = 0; d < 4; ++d)
+        num[d] = parser.value<size_t>();
+    for (int d = 0; d < 4 && parser.good(); ++d)
+    {
+        for (size_t e = 0; e < num[d] && parser.good(); ++e)
+        {
+            int tag = parser.value<int>();
+            for (int x = 0; x < (d == 0 ? 3 : 6); ++x)
+                parser.value<double>();
+            size_t numPhys = parser.value<size_t>();
+            std::vector<int> &physTags = m_entityPhysTags[std::make_pair(d, tag)];
+            for (size_t p = 0; p < numPhys && parser.good(); ++p)
+                physTags.push_back(std::abs(parser.value<int>()));
+            if (d > 0)
+            {
+                size_t numBounds = parser.value<size_t>();
+                for (size_t b = 0; b < numBounds && parser.good(); ++b)
+                    parser.value<int>();
+            }
+        }
+    }
+    return parser.good();
+}
+
+bool MshModel::readNodes(Parser &parser)
+{
+    size_t numBlocks = parser.value<size_t>();
+    size_t numNodes = parser.value<size_t>();
+    parser.value<size_t>(); // minNodeTag
+    size_t maxNodeTag = parser.value<size_t>();
+    if (!parser.good())
+        return false;
+
+    m_nodeTags.resize(numNodes);
+    m_nodeCoords.resize(numNodes * 3);
+    size_t offset = 0;
+    std::vector<const char *> starts;
+    for (size_t b = 0; b < numBlocks && parser.good(); ++b)
+    {
+        int entityDim = parser.value<int>();
+        parser.value<int>(); // entityTag
+        int parametric = parser.value<int>();
+        size_t n = parser.value<size_t>();
+        int numValues = 3 + (parametric ? entityDim : 0);
+        if (!parser.good() || offset + n > numNodes)
+            return false;
+
+        bool error = false;
+        parser.records(n, sizeof(size_t), starts);
+        if (!parser.good())
+            return false;
+#pragma omp parallel for schedule(static) num_threads(m_numThreads) reduction(|| : error)
+        for (size_t i = 0; i < n; ++i)
+        {
+            const char *p = starts[i];
+            m_nodeTags[offset + i] = parser.valueAt<size_t>(p, error);
+        }
+
+        parser.records(n, numValues * sizeof(double), starts);
+        if (!parser.good())
+            return false;
+#pragma omp parallel for schedule(static) num_threads(m_numThreads) reduction(|| : error)
+        for (size_t i = 0; i < n; ++i)
+        {
+            const char *p = starts[i];
+            for (int x = 0; x < 3; ++x)
+                m_nodeCoords[(offset + i) * 3 + x] = parser.valueAt<double>(p, error);
+        }
+        if (error)
+            return false;
+        offset += n;
+    }
+    if (offset != numNodes)
+        return false;
+
+    m_nodeIds.assign(maxNodeTag + 1, 0);
+    for (size_t i = 0; i < numNodes; ++i)
+    {
+        if (m_nodeTags[i] > maxNodeTag)
+            return false;
+        m_nodeIds[m_nodeTags[i]] = i;
+    }
+    return parser.good();
+}
+
+bool MshModel::readElements(Parser &parser)
+{
+    size_t numBlocks = parser.value<size_t>();
+    parser.value<size_t>(); // numElements
+    parser.value<size_t>(); // minElementTag
+    m_maxElTag = parser.value<size_t>();
+
+    std::vector<const char *> starts;
+    for (size_t b = 0; b < numBlocks && parser.good(); ++b)
+    {
+        Block block;
+        block.dim = parser.value<int>();
+        block.entity = parser.value<int>();
+        block.type = parser.value<int>();
+        size_t n = parser.value<size_t>();
+        if (!parser.good() || !referenceElement::isSupported(block.type))
+            return false;
+
+        std::string name;
+        int dim, order, numNodes, numPrimaryNodes;
+        std::vector<double> localNodeCoord;
+        referenceElement::getProperties(block.type, name, dim, order, numNodes, localNodeCoord, numPrimaryNodes);
+
+        bool error = false;
+        parser.records(n, (1 + numNodes) * sizeof(size_t), starts);
+        if (!parser.good())
+            return false;
+        block.elTags.resize(n);
+        block.nodeTags.resize(n * numNodes);
+#pragma omp parallel for schedule(static) num_threads(m_numThreads) reduction(|| : error)
+        for (size_t i = 0; i < n; ++i)
+        {
+            const char *p = starts[i];
+            block.elTags[i] = parser.valueAt<size_t>(p, error);
+            for (int j = 0; j < numNodes; ++j)
+                block.nodeTags[i * numNodes + j] = parser.valueAt<size_t>(p, error);
+        }
+        if (error)
+            return false;
+        m_blocks.push_back(std::move(block));
+    }
+    return parser.good();
+}
+
+std::vector<MshModel::Block const *> MshModel::getBlocks(int elementType, int tag)
+{
+    std::vector<Block const *> blocks;
+    for (auto const &b : m_blocks)
+    {
+        if (b.type == elementType && (tag < 0 || b.entity == tag))
+            blocks.push_back(&b);
+    }
+    std::stable_sort(blocks.begin(), blocks.end(),
+                     [](Block const *a, Block const *b) { return a->entity < b->entity; });
+    return blocks;
+}
+
+int MshModel::getDimension()
+{
+    return m_dim;
+}
+
+void MshModel::getPhysicalGroups(std::vector<std::pair<int, std::string>> &physGroups, int dim)
+{
+    std::set<int> tags;
+    for (auto const &e : m_entityPhysTags)
+    {
+        if (e.first.first == dim)
+            tags.insert(e.second.begin(), e.second.end());
+    }
+    physGroups.clear();
+    for (int tag : tags)
+    {
+        auto name = m_physNames.find(std::make_pair(dim, tag));
+        physGroups.push_back(std::make_pair(tag, name != m_physNames.end() ? name->second : ""));
+    }
+}
+
+void MshModel::getNodesForPhysicalGroup(int dim, int tag, std::vector<size_t> &nodeTags)
+{
+    nodeTags.clear();
+    for (auto const &b : m_blocks)
+    {
+        auto physTags = m_entityPhysTags.find(std::make_pair(b.dim, b.entity));
+        if (b.dim == dim && physTags != m_entityPhysTags.end() &&
+            std::find(physTags->second.begin(), physTags->second.end(), tag) != physTags->second.end())
+            nodeTags.insert(nodeTags.end(), b.nodeTags.begin(), b.nodeTags.end());
+    }
+    std::sort(nodeTags.begin(), nodeTags.end());
+    nodeTags.erase(std::unique(nodeTags.begin(), nodeTags.end()), nodeTags.end());
+}
+
+void MshModel::getNodes(std::vector<size_t> &nodeTags, std::vector<double> &coord)
+{
+    nodeTags = m_nodeTags;
+    coord = m_nodeCoords;
+}
+
+void MshModel::getElementTypes(std::vector<int> &elementTypes, int dim)
+{
+    std::set<int> types;
+    for (auto const &b : m_blocks)
+    {
+        if (dim < 0 || b.dim == dim)
+            types.insert(b.type);
+    }
+    elementTypes.assign(types.begin(), types.end());
+}
+
+int MshModel::getElementType(std::string familyName, int order)
+{
+    return referenceElement::getType(familyName, order);
+}
+
+void MshModel::getElementProperties(int elementType, std::string &elementName, int &dim, int &order, int &numNodes,
+                                    std::vector<double> &localNodeCoord, int &numPrimaryNodes)
+{
+    referenceElement::getProperties(elementType, elementName, dim, order, numNodes, localNodeCoord, numPrimaryNodes);
+}
+
+void MshModel::getElementsByType(int elementType, std::vector<size_t> &elementTags, std::vector<size_t> &nodeTags)
+{
+    elementTags.clear();
+    nodeTags.clear();
+    for (Block const *b : getBlocks(elementType))
+    {
+        elementTags.insert(elementTags.end(), b->elTags.begin(), b->elTags.end());
+        nodeTags.insert(nodeTags.end(), b->nodeTags.begin(), b->nodeTags.end());
+    }
+}
+
+/**
+ * Node tags of the sub-entities (edges or faces) of all the elements of
+ * a given type, following the local numbering of referenceElement.
+ */
+static void getSubEntityNodes(std::vector<size_t> const &elNodeTags, int numNodes,
+                              std::vector<std::vector<int>> const &subEntities, int numThreads,
+                              std::vector<size_t> &nodeTags)
+{
+    size_t numEl = elNodeTags.size() / numNodes;
+    size_t numSubNodes = 0;
+    for (auto const &s : subEntities)
+        numSubNodes += s.size();
+
+    nodeTags.resize(numEl * numSubNodes);
+#pragma omp parallel for schedule(static) num_threads(numThreads)
+    for (size_t el = 0; el < numEl; ++el)
+    {
+        size_t i = el * numSubNodes;
+        for (auto const &s : subEntities)
+        {
+            for (int n : s)
+                nodeTags[i++] = elNodeTags[el * numNodes + n];
+        }
+    }
+}
+
+void MshModel::getElementEdgeNodes(int elementType, std::vector<size_t> &nodeTags)
+{
+    std::vector<size_t> elTags, elNodeTags;
+    getElementsByType(elementType, elTags, elNodeTags);
+    getSubEntityNodes(elNodeTags, elTags.empty() ? 1 : elNodeTags.size() / elTags.size(),
+                      referenceElement::getEdges(elementType), m_numThreads, nodeTags);
+}
+
+void MshModel::getElementFaceNodes(int elementType, int faceType, std::vector<size_t> &nodeTags)
+{
+    if (faceType != 3)
+        Fatal_Error("Only triangular faces are supported")
+    std::vector<size_t> elTags, elNodeTags;
+    getElementsByType(elementType, elTags, elNodeTags);
+    getSubEntityNodes(elNodeTags, elTags.empty() ? 1 : elNodeTags.size() / elTags.size(),
+                      referenceElement::getFaces(elementType), m_numThreads, nodeTags);
+}
+
+void MshModel::getBarycenters(int elementType, std::vector<double> &barycenters)
+{
+    std::string name;
+    int dim, order, numNodes, numPrimaryNodes;
+    std::vector<double> localNodeCoord;
+    referenceElement::getProperties(elementType, name, dim, order, numNodes, localNodeCoord, numPrimaryNodes);
+
+    std::vector<size_t> elTags, elNodeTags;
+    getElementsByType(elementType, elTags, elNodeTags);
+    barycenters.assign(elTags.size() * 3, 0.0);
+#pragma omp parallel for schedule(static) num_threads(m_numThreads)
+    for (size_t el = 0; el < elTags.size(); ++el)
+    {
+        for (int n = 0; n < numPrimaryNodes; ++n)
+        {
+            const double *x = nodeCoord(elNodeTags[el * numNodes + n]);
+            for (int i = 0; i < 3; ++i)
+                barycenters[el * 3 + i] += x[i];
+        }
+        for (int i = 0; i < 3; ++i)
+            barycenters[el * 3 + i] /= numPrimaryNodes;
+    }
+}
+
+void MshModel::getIntegrationPoints(int elementType, std::string integrationType,
+                                    std::vector<double> &localCoord, std::vector<double> &weights)
+{
+    if (integrationType.compare(0, 5, "Gauss") != 0)
+    {
+        std::string message = "Integration type " + integrationType + " not supported";
+        Fatal_Error(message.c_str())
+    }
+    referenceElement::getIntegrationPoints(elementType, std::stoi(integrationType.substr(5)), localCoord, weights);
+}
+
+void MshModel::getBasisFunctions(int elementType, std::vector<double> const &localCoord, std::string functionSpaceType,
+                                 std::vector<double> &basisFunctions)
+{
+    bool grad = functionSpaceType.compare(0, 4, "Grad") == 0;
+    std::string space = grad ? functionSpaceType.substr(4) : functionSpaceType;
+    if (space != "Lagrange" && space != "IsoParametric")
+    {
+        std::string message = "Function space " + functionSpaceType + " not supported";
+        Fatal_Error(message.c_str())
+    }
+    referenceElement::getBasisFunctions(elementType, localCoord, grad, basisFunctions);
+}
+
+/**
+ * Same convention as Gmsh: the jacobian is stored by rows of parametric
+ * derivatives [dx/du, dy/du, dz/du, dx/dv, ...]. For lines and triangles it
+ * is completed with unit vectors orthogonal to the element, so that it can
+ * be inverted, and the determinant is the length/area ratio.
+ */
+void MshModel::getJacobians(int elementType, std::vector<double> const &localCoord, std::vector<double> &jacobians,
+                            std::vector<double> &determinants, std::vector<double> &coord, int tag)
+{
+    std::string name;
+    int dim, order, numNodes, numPrimaryNodes;
+    std::vector<double> localNodeCoord;
+    referenceElement::getProperties(elementType, name, dim, order, numNodes, localNodeCoord, numPrimaryNodes);
+
+    size_t numPoints = localCoord.size() / 3;
+    std::vector<double> basis, gradBasis;
+    referenceElement::getBasisFunctions(elementType, localCoord, false, basis);
+    referenceElement::getBasisFunctions(elementType, localCoord, true, gradBasis);
+
+    std::vector<size_t> elNodeTags;
+    for (Block const *b : getBlocks(elementType, tag))
+        elNodeTags.insert(elNodeTags.end(), b->nodeTags.begin(), b->nodeTags.end());
+    size_t numEl = elNodeTags.size() / numNodes;
+
+    jacobians.resize(numEl * numPoints * 9);
+    determinants.resize(numEl * numPoints);
+    coord.resize(numEl * numPoints * 3);
+
+    auto cross = [](const double *a, const double *b, double *c)
+    {
+        c[0] = a[1] * b[2] - a[2] * b[1];
+        c[1] = a[2] * b[0] - a[0] * b[2];
+        c[2] = a[0] * b[1] - a[1] * b[0];
+    };
+    auto normalize = [](double *a)
+    {
+        double norm = std::sqrt(a[0] * a[0] + a[1] * a[1] + a[2] * a[2]);
+        if (norm > 0)
+            for (int i = 0; i < 3; ++i)
+                a[i] /= norm;
+        return norm;
+    };
+
+#pragma omp parallel for schedule(static) num_threads(m_numThreads)
+    for (size_t el = 0; el < numEl; ++el)
+    {
+        for (size_t g = 0; g < numPoints; ++g)
+        {
+            double *J = &jacobians[(el * numPoints + g) * 9];
+            double *X = &coord[(el * numPoints + g) * 3];
+            std::fill(J, J + 9, 0.0);
+            std::fill(X, X + 3, 0.0);
+            for (int n = 0; n < numNodes; ++n)
+            {
+                const double *x = nodeCoord(elNodeTags[el * numNodes + n]);
+                const double *dN = &gradBasis[(g * numNodes + n) * 3];
+                for (int i = 0; i < 3; ++i)
+                {
+                    X[i] += basis[g * numNodes + n] * x[i];
+                    for (int u = 0; u < 3; ++u)
+                        J[u * 3 + i] += dN[u] * x[i];
+                }
+            }
+
+            double &det = determinants[el * numPoints + g];
+            switch (dim)
+            {
+            case 0:
+            {
+                det = 1;
+                J[0] = J[4] = J[8] = 1;
+                break;
+            }
+            case 1:
+            {
+                double *a = J, *b = J + 3, *c = J + 6;
+                det = std::sqrt(a[0] * a[0] + a[1] * a[1] + a[2] * a[2]);
+                if ((std::fabs(a[0]) >= std::fabs(a[1]) && std::fabs(a[0]) >= std::fabs(a[2])) ||
+                    (std::fabs(a[1]) >= std::fabs(a[0]) && std::fabs(a[1]) >= std::fabs(a[2])))
+                {
+                    b[0] = a[1];
+                    b[1] = -a[0];
+                    b[2] = 0;
+                }
+                else
+                {
+                    b[0] = 0;
+                    b[1] = a[2];
+                    b[2] = -a[1];
+                }
+                normalize(b);
+                cross(a, b, c);
+                normalize(c);
+                break;
+            }
+            case 2:
+            {
+                cross(J, J + 3, J + 6);
+                det = normalize(J + 6);
+                break;
+            }
+            case 3:
+            {
+                double c[3];
+                cross(J + 3, J + 6, c);
+                det = J[0] * c[0] + J[1] * c[1] + J[2] * c[2];
+                break;
+            }
+            }
+        }
+    }
+}
+
+int MshModel::addElements(int dim, int elementType, std::vector<size_t> const &nodeTags)
+{
+    int entity = 0;
+    for (auto const &e : m_entityPhysTags)
+    {
+        if (e.first.first == dim)
+            entity = std::max(entity, e.first.second);
+    }
+    for (auto const &b : m_blocks)
+    {
+        if (b.dim == dim)
+            entity = std::max(entity, b.entity);
+    }
+    entity++;
+
+    std::string name;
+    int elDim, order, numNodes, numPrimaryNodes;
+    std::vector<double> localNodeCoord;
+    referenceElement::getProperties(elementType, name, elDim, order, numNodes, localNodeCoord, numPrimaryNodes);
+
+    Block block{dim, entity, elementType, {}, nodeTags};
+    block.elTags.resize(nodeTags.size() / numNodes);
+    for (size_t i = 0; i < block.elTags.size(); ++i)
+        block.elTags[i] = ++m_maxElTag;
+    m_blocks.push_back(std::move(block));
+    m_entityPhysTags[std::make_pair(dim, entity)];
+    return entity;
+}
@@ -0,0 +1,292 @@
+#include <Eigen/Dense>
+#include <cmath>
+#include <map>
+
+#include "referenceElement.h"
+#include "utils.h"
+
+namespace referenceElement
+{
+    /**
+     * Description of a Lagrange simplex. The node parametric coordinates
+     * define the nodal basis through the inverse of the Vandermonde matrix
+     * of the monomials u^i v^j w^k (i+j+k <= order).
+     */
+    struct Simplex
+    {
+        std::string name;
+        std::string family;
+        int dim;
+        int order;
+        int numPrimaryNodes;
+        std::vector<std::vector<double>> nodes;    // Parametric coordinates of the nodes
+        std::vector<std::vector<int>> edges;       // Local nodes of the edges
+        std::vector<std::vector<int>> faces;       // Local nodes of the faces
+        std::vector<std::vector<int>> monomials;   // Exponents (i, j, k) of the monomials
+        Eigen::MatrixXd coefficients;              // Monomial coefficients of each basis function (column)
+    };
+
+    Simplex makeSimplex(std::string name, std::string family, int dim, int order, int numPrimaryNodes,
+                        std::vector<std::vector<double>> nodes,
+                        std::vector<std::vector<int>> edges,
+                        std::vector<std::vector<int>> faces)
+    {
+        Simplex s{name, family, dim, order, numPrimaryNodes, nodes, edges, faces, {}, {}};
+        for (int k = 0; k <= (dim > 2 ? order : 0); ++k)
+            for (int j = 0; j <= (dim > 1 ? order - k : 0); ++j)
+                for (int i = 0; i <= order - j - k; ++i)
+                    s.monomials.push_back({i, j, k});
+
+        int n = (int)nodes.size();
+        Eigen::MatrixXd V(n, n);
+        for (int a = 0; a < n; ++a)
+            for (int m = 0; m < n; ++m)
+                V(a, m) = std::pow(nodes[a][0], s.monomials[m][0]) *
+                          std::pow(nodes[a][1], s.monomials[m][1]) *
+                          std::pow(nodes[a][2], s.monomials[m][2]);
+        s.coefficients = V.inverse();
+        return s;
+    }
+
+    std::map<int, Simplex> const &simplices()
+    {
+        static const std::map<int, Simplex> table = {
+            {15, makeSimplex("Point", "point", 0, 0, 1, {{0, 0, 0}}, {}, {})},
+            {1, makeSimplex("Line 2", "line", 1, 1, 2, {{-1, 0, 0}, {1, 0, 0}}, {{0, 1}}, {})},
+            {8, makeSimplex("Line 3", "line", 1, 2, 2, {{-1, 0, 0}, {1, 0, 0}, {0, 0, 0}}, {{0, 1, 2}}, {})},
+            {2, makeSimplex("Triangle 3", "triangle", 2, 1, 3, {{0, 0, 0}, {1, 0, 0}, {0, 1, 0}},
+                            {{0, 1}, {1, 2}, {2, 0}}, {{0, 1, 2}})},
+            {9, makeSimplex("Triangle 6", "triangle", 2, 2, 3,
+                            {{0, 0, 0}, {1, 0, 0}, {0, 1, 0}, {0.5, 0, 0}, {0.5, 0.5, 0}, {0, 0.5, 0}},
+                            {{0, 1, 3}, {1, 2, 4}, {2, 0, 5}}, {{0, 1, 2, 3, 4, 5}})},
+            {4, makeSimplex("Tetrahedron 4", "tetrahedron", 3, 1, 4, {{0, 0, 0}, {1, 0, 0}, {0, 1, 0}, {0, 0, 1}},
+                            {{0, 1}, {1, 2}, {2, 0}, {3, 0}, {3, 2}, {3, 1}},
+                            {{0, 2, 1}, {0, 1, 3}, {0, 3, 2}, {3, 1, 2}})},
+            {11, makeSimplex("Tetrahedron 10", "tetrahedron", 3, 2, 4,
+                             {{0, 0, 0}, {1, 0, 0}, {0, 1, 0}, {0, 0, 1}, {0.5, 0, 0},
+                              {0.5, 0.5, 0}, {0, 0.5, 0}, {0, 0, 0.5}, {0, 0.5, 0.5}, {0.5, 0, 0.5}},
+                             {{0, 1, 4}, {1, 2, 5}, {2, 0, 6}, {3, 0, 7}, {3, 2, 8}, {3, 1, 9}},
+                             {{0, 2, 1, 6, 5, 4}, {0, 1, 3, 4, 9, 7}, {0, 3, 2, 7, 8, 6}, {3, 1, 2, 9, 5, 8}})},
+        };
+        return table;
+    }
+
+    Simplex const &simplex(int elementType)
+    {
+        auto it = simplices().find(elementType);
+        if (it == simplices().end())
+        {
+            std::string message = "Element type " + std::to_string(elementType) + " not supported";
+            Fatal_Error(message.c_str())
+        }
+        return it->second;
+    }
+
+    bool isSupported(int elementType)
+    {
+        return simplices().count(elementType) > 0;
+    }
+
+    int getType(std::string familyName, int order)
+    {
+        for (auto const &s : simplices())
+        {
+            if (s.second.family == familyName && (s.second.order == order || s.second.dim == 0))
+                return s.first;
+        }
+        return -1;
+    }
+
+    void getProperties(int elementType, std::string &name, int &dim, int &order, int &numNodes,
+                       std::vector<double> &localNodeCoord, int &numPrimaryNodes)
+    {
+        Simplex const &s = simplex(elementType);
+        name = s.name;
+        dim = s.dim;
+        order = s.order;
+        numNodes = (int)s.nodes.size();
+        numPrimaryNodes = s.numPrimaryNodes;
+        localNodeCoord.clear();
+        for (auto const &node : s.nodes)
+            localNodeCoord.insert(localNodeCoord.end(), node.begin(), node.begin() + dim);
+    }
+
+    /**
+     * Gauss-Legendre points on [-1, 1] (Newton iterations on the Legendre
+     * polynomial, starting from the Chebyshev approximation of the roots).
+     */
+    void gaussLegendre(int n, std::vector<double> &x, std::vector<double> &w)
+    {
+        x.resize(n);
+        w.resize(n);
+        for (int i = 0; i < n; ++i)
+        {
+            double z = -std::cos(M_PI * (i + 0.75) / (n + 0.5));
+            double dp = 1;
+            for (int it = 0; it < 100; ++it)
+            {
+                double p0 = 1, p1 = z;
+                for (int k = 2; k <= n; ++k)
+                {
+                    double p2 = ((2 * k - 1) * z * p1 - (k - 1) * p0) / k;
+                    p0 = p1;
+                    p1 = p2;
+                }
+                dp = n * (z * p1 - p0) / (z * z - 1);
+                double dz = p1 / dp;
+                z -= dz;
+                if (std::fabs(dz) < 1e-16)
+                    break;
+            }
+            x[i] = z;
+            w[i] = 2 / ((1 - z * z) * dp * dp);
+        }
+    }
+
+    void getIntegrationPoints(int elementType, int degree, std::vector<double> &localCoord,
+                              std::vector<double> &weights)
+    {
+        Simplex const &s = simplex(elementType);
+        localCoord.clear();
+        weights.clear();
+        auto add = [&](double u, double v, double w, double q)
+        {
+            localCoord.insert(localCoord.end(), {u, v, w});
+            weights.push_back(q);
+        };
+
+        switch (s.dim)
+        {
+        case 0:
+        {
+            add(0, 0, 0, 1);
+            break;
+        }
+        case 1:
+        {
+            std::vector<double> x, w;
+            gaussLegendre(degree / 2 + 1, x, w);
+            for (size_t g = 0; g < x.size(); ++g)
+                add(x[g], 0, 0, w[g]);
+            break;
+        }
+        case 2:
+        {
+            if (degree <= 1)
+            {
+                add(1. / 3, 1. / 3, 0, 0.5);
+            }
+            else if (degree == 2)
+            {
+                add(1. / 6, 1. / 6, 0, 1. / 6);
+                add(2. / 3, 1. / 6, 0, 1. / 6);
+                add(1. / 6, 2. / 3, 0, 1. / 6);
+            }
+            else if (degree <= 4)
+            {
+                const double a = 0.445948490915965, wa = 0.223381589678011 / 2;
+                const double b = 0.091576213509771, wb = 0.109951743655322 / 2;
+                add(a, a, 0, wa);
+                add(1 - 2 * a, a, 0, wa);
+                add(a, 1 - 2 * a, 0, wa);
+                add(b, b, 0, wb);
+                add(1 - 2 * b, b, 0, wb);
+                add(b, 1 - 2 * b, 0, wb);
+            }
+            break;
+        }
+        case 3:
+        {
+            if (degree <= 1)
+            {
+                add(0.25, 0.25, 0.25, 1. / 6);
+            }
+            else if (degree == 2)
+            {
+                const double a = 0.5854101966249685, b = 0.1381966011250105;
+                add(b, b, b, 1. / 24);
+                add(a, b, b, 1. / 24);
+                add(b, a, b, 1. / 24);
+                add(b, b, a, 1. / 24);
+            }
+            else if (degree <= 5)
+            {
+                const double a[2] = {0.0927352503108912264023, 0.3108859192633006097973};
+                const double wa[2] = {0.0122488405193936582572, 0.0187813209530026417998};
+                for (int i = 0; i < 2; ++i)
+                {
+                    double c = 1 - 3 * a[i];
+                    add(a[i], a[i], a[i], wa[i]);
+                    add(c, a[i], a[i], wa[i]);
+                    add(a[i], c, a[i], wa[i]);
+                    add(a[i], a[i], c, wa[i]);
+                }
+                const double e = 0.0455037041256496494918, f = 0.5 - e, we = 0.0070910034628469110730;
+                add(e, e, f, we);
+                add(e, f, e, we);
+                add(f, e, e, we);
+                add(e, f, f, we);
+                add(f, e, f, we);
+                add(f, f, e, we);
+            }
+            break;
+        }
+        }
+
+        if (weights.empty())
+        {
+            std::string message = "Quadrature of degree " + std::to_string(degree) + " not available for " + s.name;
+            Fatal_Error(message.c_str())
+        }
+    }
+
+    void getBasisFunctions(int elementType, std::vector<double> const &localCoord, bool grad,
+                           std::vector<double> &basisFunctions)
+    {
+        Simplex const &s = simplex(elementType);
+        int numNodes = (int)s.nodes.size();
+        int numComponents = grad ? 3 : 1;
+        size_t numPoints = localCoord.size() / 3;
+        basisFunctions.assign(numPoints * numNodes * numComponents, 0.0);
+
+        // d(u^i)/du = i u^(i-1), with the convention 0 * u^-1 = 0
+        auto power = [](double x, int i) { return i < 0 ? 0.0 : std::pow(x, i); };
+
+        for (size_t g = 0; g < numPoints; ++g)
+        {
+            const double *u = &localCoord[g * 3];
+            for (size_t m = 0; m < s.monomials.size(); ++m)
+            {
+                const int *e = s.monomials[m].data();
+                double value[3] = {power(u[0], e[0]), power(u[1], e[1]), power(u[2], e[2])};
+                double monomial[3];
+                if (grad)
+                {
+                    monomial[0] = e[0] * power(u[0], e[0] - 1) * value[1] * value[2];
+                    monomial[1] = e[1] * value[0] * power(u[1], e[1] - 1) * value[2];
+                    monomial[2] = e[2] * value[0] * value[1] * power(u[2], e[2] - 1);
+                }
+                else
+                {
+                    monomial[0] = value[0] * value[1] * value[2];
+                }
+
+                for (int i = 0; i < numNodes; ++i)
+                {
+                    for (int c = 0; c < numComponents; ++c)
+                        basisFunctions[(g * numNodes + i) * numComponents + c] += s.coefficients(m, i) * monomial[c];
+                }
+            }
+        }
+    }
+
+    std::vector<std::vector<int>> const &getEdges(int elementType)
+    {
+        return simplex(elementType).edges;
+    }
+
+    std::vector<std::vector<int>> const &getFaces(int elementType)
+    {
+        return simplex(elementType).faces;
+    }
+}
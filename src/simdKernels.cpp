@@ -0,0 +1,357 @@
+#include <vector>
+
+#include "simdKernels.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DGALERKIN_SIMD_X86 1
+#define DGALERKIN_TARGET(isa) __attribute__((target(isa)))
+#define DGALERKIN_INLINE inline __attribute__((always_inline))
+#else
+#define DGALERKIN_SIMD_X86 0
+#define DGALERKIN_INLINE inline
+#endif
+
+namespace simd
+{
+    /**
+     * Update of W affine elements, lane l = element l of the batch.
+     * All the loops over the lanes have a compile time trip count and no
+     * dependency, so that they map to single vector instructions.
+     *
+     * NN and DIM are the number of nodes and the dimension of the element
+     * when the kernel is specialized (see affineKernels), 0 for the generic
+     * kernel: the loops over the nodes then have a compile time trip count
+     * too and the scratch lives on the stack.
+     *
+     * QUIESCENT kernels assume a zero mean flow: the flux jacobians reduce to
+     * A_x(p, v_x) and A_x(v_x, p), so that the contravariant flux of the
+     * pressure only depends on the velocity and the one of each velocity
+     * component only on the pressure.
+     */
+    template <int W, int NN = 0, int DIM = 0, bool QUIESCENT = false>
+    static DGALERKIN_INLINE void affineUpdateImpl(const AffineBatch &b)
+    {
+        const int N = NN > 0 ? NN : b.numNodes;
+        const int dim = DIM > 0 ? DIM : b.dim;
+        const int K = dim * N;
+
+        constexpr int fixedScratchSize = NN > 0 ? ((4 + DIM + 2) * NN + 4 * 3 + 3 * 4 + 1) * W : 1;
+        alignas(64) double fixedScratch[fixedScratchSize];
+        double *uL = fixedScratch;         // [k][j][l] solution
+        if constexpr (NN == 0)
+        {
+            thread_local std::vector<double> scratch;
+            scratch.resize((4 * N + K + 2 * N) * W + 4 * 3 * W + 3 * 4 * W + W);
+            uL = scratch.data();
+        }
+        double *Fc = uL + 4 * N * W;       // [d*N+j][l] contravariant flux
+        double *R = Fc + K * W;            // [i][l] residual
+        double *out = R + N * W;           // [i][l] updated solution of one equation
+        double *iJ = out + N * W;          // [d][x][l] inverse jacobian times detJ
+        double *cB = iJ + 3 * 3 * W;       // [d][k][l] contravariant flux jacobian
+        double *scale = cB + 3 * 4 * W;    // [l] dt / detJ
+
+        // AoS -> AoSoA
+        for (int k = 0; k < 4; ++k)
+            for (int j = 0; j < N; ++j)
+            {
+#pragma omp simd
+                for (int l = 0; l < W; ++l)
+                    uL[(k * N + j) * W + l] = b.u[k][l * N + j];
+            }
+        for (int d = 0; d < dim; ++d)
+            for (int x = 0; x < 3; ++x)
+            {
+#pragma omp simd
+                for (int l = 0; l < W; ++l)
+                    iJ[(d * 3 + x) * W + l] = b.det[l] * b.invJ[l * 9 + d * 3 + x];
+            }
+#pragma omp simd
+        for (int l = 0; l < W; ++l)
+            scale[l] = b.dt / b.det[l];
+
+        // Residuals of the four equations are computed before u is overwritten
+        for (int eq = 0; eq < 4; ++eq)
+        {
+            // detJ * du_d/dx_x * A_x(eq, k)
+            for (int d = 0; d < dim; ++d)
+                for (int k = 0; k < 4; ++k)
+                {
+                    const double a0 = b.A[0 * 16 + eq * 4 + k];
+                    const double a1 = b.A[1 * 16 + eq * 4 + k];
+                    const double a2 = b.A[2 * 16 + eq * 4 + k];
+#pragma omp simd
+                    for (int l = 0; l < W; ++l)
+                        cB[(d * 4 + k) * W + l] = iJ[(d * 3 + 0) * W + l] * a0 +
+                                                  iJ[(d * 3 + 1) * W + l] * a1 +
+                                                  iJ[(d * 3 + 2) * W + l] * a2;
+                }
+
+            // Contravariant flux
+            for (int d = 0; d < dim; ++d)
+                for (int j = 0; j < N; ++j)
+                {
+                    double *fc = &Fc[(d * N + j) * W];
+                    if (QUIESCENT && eq == 0)
+                    {
+#pragma omp simd
+                        for (int l = 0; l < W; ++l)
+                            fc[l] = cB[(d * 4 + 1) * W + l] * uL[(1 * N + j) * W + l] +
+                                    cB[(d * 4 + 2) * W + l] * uL[(2 * N + j) * W + l] +
+                                    cB[(d * 4 + 3) * W + l] * uL[(3 * N + j) * W + l];
+                    }
+                    else if (QUIESCENT)
+                    {
+#pragma omp simd
+                        for (int l = 0; l < W; ++l)
+                            fc[l] = cB[(d * 4 + 0) * W + l] * uL[(0 * N + j) * W + l];
+                    }
+                    else
+                    {
+#pragma omp simd
+                        for (int l = 0; l < W; ++l)
+                            fc[l] = cB[(d * 4 + 0) * W + l] * uL[(0 * N + j) * W + l] +
+                                    cB[(d * 4 + 1) * W + l] * uL[(1 * N + j) * W + l] +
+                                    cB[(d * 4 + 2) * W + l] * uL[(2 * N + j) * W + l] +
+                                    cB[(d * 4 + 3) * W + l] * uL[(3 * N + j) * W + l];
+                    }
+                }
+
+            if constexpr (NN > 0)
+            {
+                /**
+                 * Compile time sizes: the node loops are nested in the lane
+                 * loop, so that the accumulators stay in vector registers and
+                 * the reductions are unrolled.
+                 */
+                // R = D * Fc - F
+                for (int i = 0; i < N; ++i)
+                {
+                    const double *Di = &b.D[i * K];
+#pragma omp simd
+                    for (int l = 0; l < W; ++l)
+                    {
+                        double r = 0;
+                        for (int m = 0; m < K; ++m)
+                            r += Di[m] * Fc[m * W + l];
+                        R[i * W + l] = r;
+                    }
+#pragma omp simd
+                    for (int l = 0; l < W; ++l)
+                        R[i * W + l] -= b.elFlux[(l * 4 + eq) * N + i];
+                }
+
+                // out = dt/detJ * M^-1 * R
+                for (int i = 0; i < N; ++i)
+                {
+                    const double *Mi = &b.M[i * N];
+#pragma omp simd
+                    for (int l = 0; l < W; ++l)
+                    {
+                        double o = 0;
+                        for (int j = 0; j < N; ++j)
+                            o += Mi[j] * R[j * W + l];
+                        out[i * W + l] = scale[l] * o;
+                    }
+                }
+            }
+            else
+            {
+                // R = D * Fc - F
+                for (int i = 0; i < N; ++i)
+                {
+                    double *r = &R[i * W];
+#pragma omp simd
+                    for (int l = 0; l < W; ++l)
+                        r[l] = -b.elFlux[(l * 4 + eq) * N + i];
+                    for (int m = 0; m < K; ++m)
+                    {
+                        const double Dim = b.D[i * K + m];
+#pragma omp simd
+                        for (int l = 0; l < W; ++l)
+                            r[l] += Dim * Fc[m * W + l];
+                    }
+                }
+
+                // out = dt/detJ * M^-1 * R
+                for (int i = 0; i < N; ++i)
+                {
+                    double *o = &out[i * W];
+#pragma omp simd
+                    for (int l = 0; l < W; ++l)
+                        o[l] = 0;
+                    for (int j = 0; j < N; ++j)
+                    {
+                        const double Mij = b.M[i * N + j];
+#pragma omp simd
+                        for (int l = 0; l < W; ++l)
+                            o[l] += Mij * R[j * W + l];
+                    }
+#pragma omp simd
+                    for (int l = 0; l < W; ++l)
+                        o[l] = scale[l] * o[l];
+                }
+            }
+
+            // AoSoA -> AoS, y = beta*y + out
+            for (int i = 0; i < N; ++i)
+            {
+#pragma omp simd
+                for (int l = 0; l < W; ++l)
+                    b.y[eq][l * N + i] = b.beta * b.y[eq][l * N + i] + out[i * W + l];
+            }
+        }
+    }
+
+    template <int NN = 0, int DIM = 0, bool QUIESCENT = false>
+    static void affineUpdateScalar(const AffineBatch &b)
+    {
+        affineUpdateImpl<1, NN, DIM, QUIESCENT>(b);
+    }
+
+#if DGALERKIN_SIMD_X86
+    template <int NN = 0, int DIM = 0, bool QUIESCENT = false>
+    DGALERKIN_TARGET("avx2,fma")
+    static void affineUpdateAVX2(const AffineBatch &b)
+    {
+        affineUpdateImpl<4, NN, DIM, QUIESCENT>(b);
+    }
+
+    template <int NN = 0, int DIM = 0, bool QUIESCENT = false>
+    DGALERKIN_TARGET("avx512f")
+    static void affineUpdateAVX512(const AffineBatch &b)
+    {
+        affineUpdateImpl<8, NN, DIM, QUIESCENT>(b);
+    }
+
+#define DGALERKIN_AFFINE_KERNELS(NN, DIM)                                                                  \
+    {{affineUpdateScalar<NN, DIM>, affineUpdateAVX2<NN, DIM>, affineUpdateAVX512<NN, DIM>},                \
+     {affineUpdateScalar<NN, DIM, true>, affineUpdateAVX2<NN, DIM, true>, affineUpdateAVX512<NN, DIM, true>}}
+#else
+#define DGALERKIN_AFFINE_KERNELS(NN, DIM)                                                                      \
+    {{affineUpdateScalar<NN, DIM>, affineUpdateScalar<NN, DIM>, affineUpdateScalar<NN, DIM>},                  \
+     {affineUpdateScalar<NN, DIM, true>, affineUpdateScalar<NN, DIM, true>, affineUpdateScalar<NN, DIM, true>}}
+#endif
+
+    /**
+     * Kernels specialized on the element size, for a general and a zero mean
+     * flow and each instruction set (indexed by Isa): triangles and
+     * tetrahedra of order 1 to 4.
+     */
+    struct AffineKernels
+    {
+        int dim;
+        int numNodes;
+        AffineUpdateKernel kernel[2][3];
+    };
+
+    static const AffineKernels affineKernels[] = {
+        {2, 3, DGALERKIN_AFFINE_KERNELS(3, 2)},
+        {2, 6, DGALERKIN_AFFINE_KERNELS(6, 2)},
+        {2, 10, DGALERKIN_AFFINE_KERNELS(10, 2)},
+        {2, 15, DGALERKIN_AFFINE_KERNELS(15, 2)},
+        {3, 4, DGALERKIN_AFFINE_KERNELS(4, 3)},
+        {3, 10, DGALERKIN_AFFINE_KERNELS(10, 3)},
+        {3, 20, DGALERKIN_AFFINE_KERNELS(20, 3)},
+        {3, 35, DGALERKIN_AFFINE_KERNELS(35, 3)},
+    };
+
+    bool isSupported(Isa isa)
+    {
+        switch (isa)
+        {
+#if DGALERKIN_SIMD_X86
+        case Isa::AVX2:
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+        case Isa::AVX512:
+            return __builtin_cpu_supports("avx512f");
+#endif
+        case Isa::Scalar:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    Isa detect()
+    {
+        if (isSupported(Isa::AVX512))
+            return Isa::AVX512;
+        if (isSupported(Isa::AVX2))
+            return Isa::AVX2;
+        return Isa::Scalar;
+    }
+
+    Isa select(std::string name)
+    {
+        Isa isa = detect();
+        if (name == "scalar")
+            isa = Isa::Scalar;
+        else if (name == "avx2" && isSupported(Isa::AVX2))
+            isa = Isa::AVX2;
+        else if (name == "avx512" && isSupported(Isa::AVX512))
+            isa = Isa::AVX512;
+        return isa;
+    }
+
+    std::string name(Isa isa)
+    {
+        switch (isa)
+        {
+        case Isa::AVX2:
+            return "avx2";
+        case Isa::AVX512:
+            return "avx512";
+        default:
+            return "scalar";
+        }
+    }
+
+    int width(Isa isa)
+    {
+        switch (isa)
+        {
+        case Isa::AVX2:
+            return 4;
+        case Isa::AVX512:
+            return 8;
+        default:
+            return 1;
+        }
+    }
+
+    AffineUpdateKernel affineUpdate(Isa isa, bool quiescent)
+    {
+        switch (isa)
+        {
+#if DGALERKIN_SIMD_X86
+        case Isa::AVX2:
+            return quiescent ? affineUpdateAVX2<0, 0, true> : affineUpdateAVX2<>;
+        case Isa::AVX512:
+            return quiescent ? affineUpdateAVX512<0, 0, true> : affineUpdateAVX512<>;
+#endif
+        default:
+            return quiescent ? affineUpdateScalar<0, 0, true> : affineUpdateScalar<>;
+        }
+    }
+
+    AffineUpdateKernel affineUpdate(Isa isa, int dim, int numNodes, bool quiescent)
+    {
+        for (const AffineKernels &k : affineKernels)
+        {
+            if (k.dim == dim && k.numNodes == numNodes)
+                return k.kernel[quiescent][static_cast<int>(isa)];
+        }
+        return affineUpdate(isa, quiescent);
+    }
+
+    bool isSpecialized(int dim, int numNodes)
+    {
+        for (const AffineKernels &k : affineKernels)
+        {
+            if (k.dim == dim && k.numNodes == numNodes)
+                return true;
+        }
+        return false;
+    }
+}
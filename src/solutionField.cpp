@@ -0,0 +1,111 @@
+#include <algorithm>
+#include <new>
+#include <utility>
+#include <omp.h>
+
+#include "solutionField.h"
+
+SolutionField::SolutionField(int numVars, size_t numEl, int elNumPts, int numThreads)
+{
+    allocate(numVars, numEl, elNumPts, numThreads);
+}
+
+SolutionField::SolutionField(const SolutionField &other)
+{
+    *this = other;
+}
+
+SolutionField::SolutionField(SolutionField &&other) noexcept
+{
+    *this = std::move(other);
+}
+
+SolutionField &SolutionField::operator=(const SolutionField &other)
+{
+    if (this == &other)
+        return *this;
+    if (m_numVars != other.m_numVars || m_numEl != other.m_numEl || m_elNumPts != other.m_elNumPts)
+        allocate(other.m_numVars, other.m_numEl, other.m_elNumPts, other.m_numThreads);
+
+    // Same static schedule as the first touch
+    const double *src = other.m_data;
+#pragma omp parallel for schedule(static) num_threads(m_numThreads)
+    for (size_t el = 0; el < m_numEl; ++el)
+    {
+        for (int v = 0; v < m_numVars; ++v)
+        {
+            size_t offset = v * m_stride + el * m_elNumPts;
+            std::copy(src + offset, src + offset + m_elNumPts, m_data + offset);
+        }
+    }
+    return *this;
+}
+
+SolutionField &SolutionField::operator=(SolutionField &&other) noexcept
+{
+    if (this == &other)
+        return *this;
+    release();
+    m_data = other.m_data;
+    m_numVars = other.m_numVars;
+    m_numEl = other.m_numEl;
+    m_elNumPts = other.m_elNumPts;
+    m_stride = other.m_stride;
+    m_numThreads = other.m_numThreads;
+    other.m_data = nullptr;
+    other.m_numVars = 0;
+    other.m_numEl = 0;
+    other.m_elNumPts = 0;
+    other.m_stride = 0;
+    return *this;
+}
+
+SolutionField::~SolutionField()
+{
+    release();
+}
+
+/**
+ * Allocate the field and set it to zero. The pages are first touched by the
+ * thread that owns the elements in the element sweeps (static schedule).
+ */
+void SolutionField::allocate(int numVars, size_t numEl, int elNumPts, int numThreads)
+{
+    release();
+    const size_t padding = alignment / sizeof(double);
+    m_numVars = numVars;
+    m_numEl = numEl;
+    m_elNumPts = elNumPts;
+    m_numThreads = numThreads;
+    m_stride = (numEl * elNumPts + padding - 1) / padding * padding;
+    if (m_stride * m_numVars == 0)
+        return;
+
+    m_data = static_cast<double *>(::operator new[](m_stride * m_numVars * sizeof(double),
+                                                    std::align_val_t(alignment)));
+    fill(0.0);
+}
+
+void SolutionField::release()
+{
+    if (m_data)
+        ::operator delete[](m_data, std::align_val_t(alignment));
+    m_data = nullptr;
+}
+
+void SolutionField::fill(double value)
+{
+    const size_t size = m_numEl * m_elNumPts;
+#pragma omp parallel for schedule(static) num_threads(m_numThreads)
+    for (size_t el = 0; el < m_numEl; ++el)
+    {
+        for (int v = 0; v < m_numVars; ++v)
+        {
+            size_t offset = v * m_stride + el * m_elNumPts;
+            std::fill(m_data + offset, m_data + offset + m_elNumPts, value);
+        }
+    }
+    // Padding
+    for (int v = 0; v < m_numVars; ++v)
+        std::fill(m_data + v * m_stride + size, m_data + (v + 1) * m_stride, value);
+}
@@ -1,6 +1,8 @@
+#include <algorithm>
 #include <chrono>
-#include <gmsh.h>
+#include <cmath>
 #include <iostream>
+#include <limits>
 #include <omp.h>
 #include <sstream>
 #include <utils.h>
@@ -8,6 +10,7 @@
 
 #include "Mesh.h"
 #include "configParser.h"
+#include "simdKernels.h"
 
 namespace solver
 {
@@ -17,380 +20,351 @@ namespace solver
      */
     int elNumNodes;
     int numNodes;
-    std::vector<std::string> g_names;
     std::vector<int> elTags;
-    std::vector<double> elFlux;
-    std::vector<double> elStiffvector;
-    std::vector<std::vector<std::vector<double>>> Flux;
 
     std::vector<std::vector<float>> data4wave;
 
     /**
-     * Perform a numerical step: u[t+1] = dt*M^-1*(S[u[t]]-F[u[t]]) + beta*u[t]
-     * for all elements in mesh object.
+     * Scratch memory of one thread of the time loop, allocated once for the
+     * whole run by the thread that uses it.
+     */
+    struct ThreadScratch
+    {
+        std::vector<double> elFlux;        // Surface terms of a batch (or block) of elements
+        std::vector<double> elStiffVector; // Stiffness vectors of an element (or block)
+        std::vector<double> blockRhs;      // Right hand side of a block, one equation
+
+        void allocate(const Config &config)
+        {
+            const int blockSize = std::max(config.elBlockSize, 1);
+            elFlux.assign(4 * elNumNodes * std::max(simd::maxWidth, blockSize), 0.0);
+            elStiffVector.assign(4 * elNumNodes * blockSize, 0.0);
+            blockRhs.assign(elNumNodes * blockSize, 0.0);
+        }
+    };
+
+    /**
+     * Batched numerical step (see numStep): the elements are processed by blocks of
+     * config.elBlockSize consecutive elements, so that the reference operators
+     * of the affine elements (differentiation and inverse mass matrices) are
+     * applied to a whole block as one matrix/matrix product.
      *
      * @param mesh Mesh object
      * @param config Configuration file
      * @param u Nodal solution vector
-     * @param Flux Nodal physical Flux
+     * @param y Output nodal vector (may be u)
      * @param beta double coefficient
+     * @param scratch Scratch memory of the calling thread
      */
-    void numStep(Mesh &mesh, Config config, std::vector<std::vector<double>> &u,
-                 std::vector<std::vector<std::vector<double>>> &Flux, double beta)
+    void numBlockStep(Mesh &mesh, const Config &config, SolutionField &u, SolutionField &y, double beta,
+                      ThreadScratch &scratch)
     {
+        const int blockSize = config.elBlockSize;
+        const int numBlocks = (mesh.getElNum() + blockSize - 1) / blockSize;
+        double *blockFlux = scratch.elFlux.data();
+        double *blockStiffVector = scratch.elStiffVector.data();
+        double *blockRhs = scratch.blockRhs.data();
+
+        mesh.precomputeFluxShared(u);
 
-        for (int eq = 0; eq < 4; ++eq)
+#pragma omp for schedule(static)
+        for (int b = 0; b < numBlocks; ++b)
         {
-            mesh.precomputeFlux(u[eq], Flux[eq], eq);
+            int el0 = b * blockSize;
+            int numEl = std::min(blockSize, mesh.getElNum() - el0);
 
-#pragma omp parallel for schedule(static) firstprivate(elFlux, elStiffvector) num_threads(config.numThreads)
-            for (int el = 0; el < mesh.getElNum(); ++el)
+            // Residuals of the four equations before u is updated in place
+            for (int k = 0; k < numEl; ++k)
+                mesh.getElFlux(el0 + k, &blockFlux[4 * k * elNumNodes]);
+            for (int eq = 0; eq < 4; ++eq)
+            {
+                double *S = &blockStiffVector[eq * numEl * elNumNodes];
+                mesh.getBlockStiffVectors(el0, numEl, u, eq, S);
+                for (int k = 0; k < numEl; ++k)
+                    eigen::minus(&S[k * elNumNodes], &blockFlux[(4 * k + eq) * elNumNodes], elNumNodes);
+            }
+
+            for (int eq = 0; eq < 4; ++eq)
             {
+                double *S = &blockStiffVector[eq * numEl * elNumNodes];
 
-                mesh.getElFlux(el, elFlux.data());
-                mesh.getElStiffVector(el, Flux[eq], u[eq], elStiffvector.data());
-                eigen::minus(elStiffvector.data(), elFlux.data(), elNumNodes);
-                eigen::linEq(&mesh.elMassMatrix(el), &elStiffvector[0], &u[eq][el * elNumNodes],
-                             config.timeStep, beta, elNumNodes);
+                // Affine elements: y = beta*y + dt/detJ * M_ref^-1 * (S - F), curved columns left to zero
+                for (int k = 0; k < numEl; ++k)
+                {
+                    double alpha = mesh.elIsAffine(el0 + k) ? config.timeStep * mesh.elMassScale(el0 + k) : 0.0;
+                    for (int i = 0; i < elNumNodes; ++i)
+                        blockRhs[k * elNumNodes + i] = alpha * S[k * elNumNodes + i];
+                }
+                lapack::gemm(&mesh.refMassMatrix(), blockRhs, &y[eq][el0 * elNumNodes],
+                             1.0, beta, elNumNodes, numEl, elNumNodes);
+
+                // Curved elements: own inverse mass matrix
+                for (int k = 0; k < numEl; ++k)
+                {
+                    int el = el0 + k;
+                    if (mesh.elIsAffine(el))
+                        continue;
+                    mesh.elMassUpdate(el, &S[k * elNumNodes], &y[eq][el * elNumNodes], config.timeStep, 1.0);
+                }
             }
         }
     }
 
     /**
-     * Solve using forward explicit scheme. O(h)
+     * Element part of a numerical step (see numStep) for the batch b of
+     * simd::width consecutive elements: y = dt*M^-1*(S[u]-F) + beta*y, the
+     * surface terms F being taken from the face flux.
      *
-     * @param u initial nodal solution vector
-     * @param mesh
-     * @param config
+     * @param mesh Mesh object
+     * @param u Nodal solution vector
+     * @param y Output nodal vector (may be u)
+     * @param beta double coefficient
+     * @param dt Time step
+     * @param b Batch id
+     * @param scratch Scratch memory of the calling thread
      */
-    void forwardEuler(std::vector<std::vector<double>> &u, Mesh &mesh, Config config)
+    void batchStep(Mesh &mesh, SolutionField &u, SolutionField &y, double beta, double dt, int b,
+                   ThreadScratch &scratch)
     {
+        const int W = simd::width(mesh.getSimdIsa());
+        double *elFlux = scratch.elFlux.data();
+        double *elStiffvector = scratch.elStiffVector.data();
 
-        /** Memory allocation */
-        elNumNodes = mesh.getElNumNodes();
-        numNodes = mesh.getNumNodes();
-        elTags = std::vector<int>(&mesh.elTag(0), &mesh.elTag(0) + mesh.getElNum());
-        elFlux.resize(elNumNodes);
-        elStiffvector.resize(elNumNodes);
-        Flux = std::vector<std::vector<std::vector<double>>>(4,
-                                                             std::vector<std::vector<double>>(mesh.getNumNodes(),
-                                                                                              std::vector<double>(3)));
-
-        /** Gmsh save init */
-        gmsh::model::list(g_names);
-        int gp_viewTag = gmsh::view::add("Pressure");
-        int gv_viewTag = gmsh::view::add("Velocity");
-        int grho_viewTag = gmsh::view::add("Density");
-        std::vector<std::vector<double>> g_p(mesh.getElNum(), std::vector<double>(elNumNodes));
-        std::vector<std::vector<double>> g_rho(mesh.getElNum(), std::vector<double>(elNumNodes));
-        std::vector<std::vector<double>> g_v(mesh.getElNum(), std::vector<double>(3 * elNumNodes));
-
-        /** Precomputation */
-        mesh.precomputeMassMatrix();
+        int el0 = b * W;
+        int numEl = std::min(W, mesh.getElNum() - el0);
+        bool affine = (numEl == W);
+        for (int l = 0; affine && l < numEl; ++l)
+            affine = mesh.elIsAffine(el0 + l);
 
-        /** Source */
-        std::vector<std::vector<int>> srcIndices;
-        for (int i = 0; i < config.sources.size(); ++i)
+        // Full batch of affine elements: one element per SIMD lane
+        if (affine)
         {
-            std::vector<int> indice;
-            for (int n = 0; n < mesh.getNumNodes(); n++)
-            {
-                std::vector<double> coord, paramCoord;
-                int _dim, _tag;
-                gmsh::model::mesh::getNode(mesh.getElNodeTags()[n], coord, paramCoord, _dim, _tag);
-                if (pow(coord[0] - config.sources[i].source[1], 2) +
-                        pow(coord[1] - config.sources[i].source[2], 2) +
-                        pow(coord[2] - config.sources[i].source[3], 2) <
-                    pow(config.sources[i].source[4], 2))
-                {
-                    indice.push_back(n);
-                }
-            }
-            srcIndices.push_back(indice);
+            simd::AffineBatch batch;
+            mesh.getAffineBatch(el0, W, u, batch);
+            for (int k = 0; k < 4; ++k)
+                batch.y[k] = y.el(k, el0);
+            for (int l = 0; l < W; ++l)
+                mesh.getElFlux(el0 + l, &elFlux[l * 4 * elNumNodes]);
+            batch.elFlux = elFlux;
+            batch.dt = dt;
+            batch.beta = beta;
+            mesh.getAffineUpdateKernel()(batch);
+            return;
         }
 
-        /** Observer */
-        std::vector<std::vector<int>> obsIndices;
-        std::vector<std::vector<double>> obsPtDistance;
-        for (int i = 0; i < config.observers.size(); ++i)
+        for (int el = el0; el < el0 + numEl; ++el)
         {
-            std::vector<int> indice;
-            std::vector<double> dist;
-            for (int n = 0; n < mesh.getNumNodes(); n++)
+            // Residuals of the four equations before u is updated in place
+            mesh.getElFlux(el, elFlux);
+            for (int eq = 0; eq < 4; ++eq)
             {
-                std::vector<double> coord, paramCoord;
-                int _dim, _tag;
-                gmsh::model::mesh::getNode(mesh.getElNodeTags()[n], coord, paramCoord, _dim, _tag);
-                double distance = sqrt(pow(coord[0] - config.observers[i][0], 2) +
-                                       pow(coord[1] - config.observers[i][1], 2) +
-                                       pow(coord[2] - config.observers[i][2], 2));
-                if (distance < config.observers[i][3])
-                {
-                    indice.push_back(n);
-                    dist.push_back(distance);
-                }
+                mesh.getElStiffVector(el, u, eq, &elStiffvector[eq * elNumNodes]);
+                eigen::minus(&elStiffvector[eq * elNumNodes], &elFlux[eq * elNumNodes], elNumNodes);
             }
-            obsIndices.push_back(indice);
-            obsPtDistance.push_back(dist);
+            double alpha = dt * mesh.elMassScale(el);
+            for (int eq = 0; eq < 4; ++eq)
+                mesh.elMassUpdate(el, &elStiffvector[eq * elNumNodes], &y[eq][el * elNumNodes], alpha, beta);
         }
+    }
 
-        /**
-         * Main Loop : Time iteration
-         */
-        std::ofstream outfile("residuals.csv");
-        outfile << "time;res_p;res_rho;res_vx;res_vy;res_vz;elapsed_time" << std::endl;
-
-        std::vector<std::ofstream> obs_outfile(config.observers.size());
-        data4wave.clear();
-        data4wave.resize(config.observers.size());
-        for (int obs = 0; obs < config.observers.size(); ++obs)
+    /**
+     * Perform a numerical step: y = dt*M^-1*(S[u]-F[u]) + beta*y for all
+     * elements in mesh object, in place (y = u: u[t+1] = dt*M^-1*(S[u[t]]-F[u[t]]) + beta*u[t])
+     * or into another vector (low-storage Runge-Kutta stages). The four equations are treated together:
+     * one pass over the faces for the numerical flux, one pass over the elements.
+     * Both passes are work-shared between the threads of the enclosing
+     * parallel region (see timeLoop): every thread of the team must call it.
+     *
+     * @param mesh Mesh object
+     * @param config Configuration file
+     * @param u Nodal solution vector
+     * @param y Output nodal vector (may be u)
+     * @param beta double coefficient
+     * @param scratch Scratch memory of the calling thread
+     */
+    void numStep(Mesh &mesh, const Config &config, SolutionField &u, SolutionField &y, double beta,
+                 ThreadScratch &scratch)
+    {
+        if (config.elBlockSize > 0)
         {
-            std::string filename = "results/observers" + std::to_string(obs + 1) + ".txt";
-            obs_outfile[obs].open(filename.c_str());
-            obs_outfile[obs] << "time;pressure;density;velocity_x;velocity_y;velocity_z" << std::endl;
+            numBlockStep(mesh, config, u, y, beta, scratch);
+            return;
         }
 
-        auto start = std::chrono::system_clock::now();
-        for (double t = config.timeStart, step = 0, tDisplay = 0; t <= config.timeEnd;
-             t += config.timeStep, tDisplay += config.timeStep, ++step)
-        {
+        mesh.precomputeFluxShared(u);
 
-            auto start_time = std::chrono::system_clock::now();
-            std::vector<double> residual(5, 0.0);
-            /**
-             *  Savings and prints
-             */
+        const int W = simd::width(mesh.getSimdIsa());
+        const int numBatches = (mesh.getElNum() + W - 1) / W;
 
-            if (tDisplay >= config.timeRate || step == 0)
-            {
-                tDisplay = 0;
+#pragma omp for schedule(static)
+        for (int b = 0; b < numBatches; ++b)
+            batchStep(mesh, u, y, beta, config.timeStep, b, scratch);
+    }
 
-/** [1] Copy solution to match GMSH format */
-#pragma omp parallel for schedule(static) num_threads(config.numThreads)
-                for (int el = 0; el < mesh.getElNum(); ++el)
-                {
-                    for (int n = 0; n < mesh.getElNumNodes(); ++n)
-                    {
-                        int elN = el * elNumNodes + n;
-                        g_p[el][n] = u[0][elN];
-                        g_rho[el][n] = u[0][elN] / (config.c0 * config.c0);
-                        g_v[el][3 * n + 0] = u[1][elN];
-                        g_v[el][3 * n + 1] = u[2][elN];
-                        g_v[el][3 * n + 2] = u[3][elN];
-                    }
-                }
+    /**
+     * Node ids inside the influence sphere of each source, retrieved with the
+     * mesh spatial index.
+     *
+     * @param mesh Mesh object
+     * @param config Configuration file
+     */
+    std::vector<std::vector<int>> locateSources(Mesh &mesh, const Config &config)
+    {
+        SpatialIndex const &index = mesh.getSpatialIndex();
+        std::vector<std::vector<int>> srcIndices;
+        std::vector<size_t> nodeIds;
+        for (int i = 0; i < config.sources.size(); ++i)
+        {
+            index.radiusSearch(&config.sources[i].source[1], config.sources[i].source[4], nodeIds);
+            srcIndices.push_back(std::vector<int>(nodeIds.begin(), nodeIds.end()));
+        }
+        return srcIndices;
+    }
 
-                /** [2] Print and compute iteration time */
-                auto end = std::chrono::system_clock::now();
-                auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(end - start);
-                gmsh::logger::write("[" + std::to_string(t) + "/" + std::to_string(config.timeEnd) + "s] Step number : " + std::to_string((int)step) + ", Elapsed time: " + std::to_string(elapsed.count()) + "s");
-                screen_display::write_string("time\t\tres_p\t\tres_rho\t\tres_vx\t\tres_vy\t\tres_vz\t\telapsed time", BOLDBLUE);
-                // mesh.writeVTK("result.vtk");
-                std::string vtu_filename = "results/result" + std::to_string((int)step) + ".vtu";
-                mesh.writeVTUb(vtu_filename, u);
-            }
+    /**
+     * Retrieve the nodes inside the influence sphere of each source and
+     * observer thanks to the mesh spatial index. If an observer sphere
+     * contains no node, the nodes of the element containing it are used.
+     *
+     * @param mesh Mesh object
+     * @param config Configuration file
+     * @param srcIndices Output node ids of each source
+     * @param obsIndices Output node ids of each observer
+     * @param obsPtDistance Output distance between each observer and its nodes
+     */
+    void locateSourcesAndObservers(Mesh &mesh, const Config &config, std::vector<std::vector<int>> &srcIndices,
+                                   std::vector<std::vector<int>> &obsIndices, std::vector<std::vector<double>> &obsPtDistance)
+    {
+        SpatialIndex const &index = mesh.getSpatialIndex();
+        std::vector<double> const &coords = mesh.getNodeCoords();
+        std::vector<size_t> nodeIds;
 
-            /**
-             * Update Source
-             */
+        srcIndices = locateSources(mesh, config);
 
-            for (int src = 0; src < config.sources.size(); ++src)
+        for (int i = 0; i < config.observers.size(); ++i)
+        {
+            std::vector<int> indice;
+            std::vector<double> dist;
+            index.radiusSearch(&config.observers[i][0], config.observers[i][3], nodeIds);
+            if (nodeIds.empty())
             {
-                if (config.sources[src].formula == "" && config.sources[src].data.empty())
+                long el = index.locateElement(&config.observers[i][0]);
+                if (el >= 0)
                 {
-                    double amp = config.sources[src].source[5];
-                    double freq = config.sources[src].source[6];
-                    double phase = config.sources[src].source[7];
-                    double duration = config.sources[src].source[8];
-                    if (t < duration)
-                        for (int n = 0; n < srcIndices[src].size(); ++n)
-                            u[0][srcIndices[src][n]] = amp * sin(2 * M_PI * freq * t + phase);
+                    for (int n = 0; n < mesh.getElNumNodes(); ++n)
+                        nodeIds.push_back(el * mesh.getElNumNodes() + n);
                 }
                 else
                 {
-                    if (config.sources[src].data.empty())
-                    {
-                        double duration = config.sources[src].source[5];
-                        if (t < duration)
-                            for (int n = 0; n < srcIndices[src].size(); ++n)
-                                u[0][srcIndices[src][n]] = config.sources[src].value(t);
-                    }
-                    else
-                    {
-                        for (int n = 0; n < srcIndices[src].size(); ++n)
-                            u[0][srcIndices[src][n]] = config.sources[src].interpolate_value(t);
-                    }
+                    screen_display::write_string("Observer " + std::to_string(i + 1) + " is outside the mesh", RED);
                 }
             }
-
-            /**
-             * First Order Euler
-             */
-            mesh.updateFlux(u, Flux, config.v0, config.c0, config.rho0);
-            numStep(mesh, config, u, Flux, 1);
-
-            /**
-             * Compute residuals
-             */
-#pragma omp parallel for schedule(static) num_threads(config.numThreads)
-            for (int el = 0; el < mesh.getElNum(); ++el)
+            for (size_t n : nodeIds)
             {
-                for (int n = 0; n < mesh.getElNumNodes(); ++n)
-                {
-                    int elN = el * elNumNodes + n;
-#pragma omp atomic update
-                    residual[0] += pow(g_p[el][n] - u[0][elN], 2);
-#pragma omp atomic update
-                    residual[1] += pow(g_rho[el][n] - u[0][elN] / (config.c0 * config.c0), 2);
-#pragma omp atomic update
-                    residual[2] += pow(g_v[el][3 * n + 0] - u[1][elN], 2);
-#pragma omp atomic update
-                    residual[3] += pow(g_v[el][3 * n + 1] - u[2][elN], 2);
-#pragma omp atomic update
-                    residual[4] += pow(g_v[el][3 * n + 2] - u[3][elN], 2);
-                }
+                double distance = sqrt(pow(coords[n * 3 + 0] - config.observers[i][0], 2) +
+                                       pow(coords[n * 3 + 1] - config.observers[i][1], 2) +
+                                       pow(coords[n * 3 + 2] - config.observers[i][2], 2));
+                indice.push_back(n);
+                dist.push_back(distance);
             }
-            outfile << t << ";";
-            std::cout << std::scientific << t << "\t";
-            auto end_time = std::chrono::system_clock::now();
-            auto elapsed_time = std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time);
-            for (int eq = 0; eq < residual.size(); ++eq)
+            obsIndices.push_back(indice);
+            obsPtDistance.push_back(dist);
+        }
+    }
+
+    /**
+     * Impose the sources on the pressure at time t.
+     *
+     * @param u nodal solution vector
+     * @param config
+     * @param srcIndices node ids of each source
+     * @param t time
+     */
+    void updateSources(SolutionField &u, const Config &config, std::vector<std::vector<int>> const &srcIndices, double t)
+    {
+        for (int src = 0; src < config.sources.size(); ++src)
+        {
+            if (config.sources[src].formula == "" && config.sources[src].data.empty())
             {
-                residual[eq] /= (mesh.getElNum() * mesh.getElNumNodes());
-                std::cout << std::scientific << residual[eq] << "\t";
-                outfile << residual[eq] << ";";
+                double amp = config.sources[src].source[5];
+                double freq = config.sources[src].source[6];
+                double phase = config.sources[src].source[7];
+                double duration = config.sources[src].source[8];
+                if (t < duration)
+                    for (int n = 0; n < srcIndices[src].size(); ++n)
+                        u[0][srcIndices[src][n]] = amp * sin(2 * M_PI * freq * t + phase);
             }
-            std::cout << elapsed_time.count() * 1.0e-6 << " s" << std::endl;
-            outfile << elapsed_time.count() * 1.0e-6 << std::endl;
-
-            /**
-             * get observers value
-             * Franke-Little interpolation method
-             */
-            for (int obs = 0; obs < config.observers.size(); ++obs)
+            else
             {
-                double p(0), rho(0), w_sum(0);
-                std::vector<double> v = {0, 0, 0};
-                for (int n = 0; n < obsIndices[obs].size(); ++n)
+                if (config.sources[src].data.empty())
+                {
+                    double duration = config.sources[src].source[5];
+                    if (t < duration)
+                        for (int n = 0; n < srcIndices[src].size(); ++n)
+                            u[0][srcIndices[src][n]] = config.sources[src].value(t);
+                }
+                else
                 {
-                    double R = config.observers[obs][3];                        //! influence sphere
-                    double w = 1.0 / (pow(obsPtDistance[obs][n], 2) + 1.0e-12); // fmax(1.0-obsPtDistance[obs][n]/R,0.0);//1.0 / pow(obsPtDistance[obs][n],2);
-                    p += u[0][obsIndices[obs][n]] * w;
-                    v[0] += u[1][obsIndices[obs][n]] * w;
-                    v[1] += u[2][obsIndices[obs][n]] * w;
-                    v[2] += u[3][obsIndices[obs][n]] * w;
-                    w_sum += w;
+                    for (int n = 0; n < srcIndices[src].size(); ++n)
+                        u[0][srcIndices[src][n]] = config.sources[src].interpolate_value(t);
                 }
-                p /= w_sum;
-                rho = p / pow(config.c0, 2);
-                v[0] /= w_sum;
-                v[1] /= w_sum;
-                v[2] /= w_sum;
-                data4wave[obs].push_back(p);
-                obs_outfile[obs] << t << ";" << rho << ";" << p << ";" << v[0] << ";" << v[1] << ";" << v[2] << std::endl;
             }
         }
-        for (int obs = 0; obs < config.observers.size(); ++obs)
+    }
+
+    /**
+     * y = x + a*z for all the variables, work-shared between the threads of
+     * the enclosing parallel region. a = 0 copies x.
+     */
+    void axpy(SolutionField &y, const SolutionField &x, double a, const SolutionField &z)
+    {
+        const int size = x.size();
+        for (int eq = 0; eq < x.numVars(); ++eq)
         {
-            io::writeWave(data4wave[obs], "results/observer_" + std::to_string(obs + 1) + ".wav", 1.0 / config.timeStep, 16, 1, 1);
-            io::writeFFT(data4wave[obs],config.timeStep,"results/observer_" + std::to_string(obs + 1));
+            double *yeq = y[eq];
+            const double *xeq = x[eq], *zeq = z[eq];
+#pragma omp for simd schedule(static) nowait
+            for (int i = 0; i < size; ++i)
+                yeq[i] = xeq[i] + a * zeq[i];
         }
-
-        outfile.close();
-        for (int obs = 0; obs < config.observers.size(); ++obs)
-            obs_outfile[obs].close();
+#pragma omp barrier
     }
 
     /**
-     * Solve using explicit Runge-Kutta integration method. O(h^4)
+     * Time loop shared by the explicit schemes. A single thread team is
+     * forked for the whole run: the work of a time step (ghost and numerical
+     * fluxes, element sweeps, updates of the scheme, residuals) is shared
+     * between its threads by work-sharing loops separated by barriers, and
+     * the sources and outputs are handled by one thread of the team.
      *
      * @param u initial nodal solution vector
      * @param mesh
      * @param config
+     * @param advance advance(scratch) advances u by one time step. It is
+     *                called by every thread of the team.
      */
-    void rungeKutta(std::vector<std::vector<double>> &u, Mesh &mesh, Config config)
+    template <typename Advance>
+    void timeLoop(SolutionField &u, Mesh &mesh, const Config &config, Advance advance)
     {
 
         /** Memory allocation */
         elNumNodes = mesh.getElNumNodes();
         numNodes = mesh.getNumNodes();
         elTags = std::vector<int>(&mesh.elTag(0), &mesh.elTag(0) + mesh.getElNum());
-        elFlux.resize(elNumNodes);
-        elStiffvector.resize(elNumNodes);
-        std::vector<std::vector<double>> k1, k2, k3, k4;
-        Flux = std::vector<std::vector<std::vector<double>>>(4,
-                                                             std::vector<std::vector<double>>(mesh.getNumNodes(),
-                                                                                              std::vector<double>(3)));
-
-        /** Gmsh save init */
-        gmsh::model::list(g_names);
-        int gp_viewTag = gmsh::view::add("Pressure");
-        int gv_viewTag = gmsh::view::add("Velocity");
-        int grho_viewTag = gmsh::view::add("Density");
-        std::vector<std::vector<double>> g_p(mesh.getElNum(), std::vector<double>(elNumNodes));
-        std::vector<std::vector<double>> g_rho(mesh.getElNum(), std::vector<double>(elNumNodes));
-        std::vector<std::vector<double>> g_v(mesh.getElNum(), std::vector<double>(3 * elNumNodes));
+
+        /** Solution at the last output, the reference of the residuals */
+        SolutionField uSaved(4, mesh.getElNum(), elNumNodes, config.numThreads);
 
         /** Precomputation (constants over time) */
         screen_display::write_string("\t>>> Precomputation", BLUE);
         mesh.precomputeMassMatrix();
         screen_display::write_string("\t>>> precomputeMassMatrix", BLUE);
 
-        /** Source */
+        /** Sources and observers */
         std::vector<std::vector<int>> srcIndices;
-        for (int i = 0; i < config.sources.size(); ++i)
-        {
-            std::vector<int> indice;
-            for (int n = 0; n < mesh.getNumNodes(); n++)
-            {
-                std::vector<double> coord, paramCoord;
-                int _dim, _tag;
-                gmsh::model::mesh::getNode(mesh.getElNodeTags()[n], coord, paramCoord, _dim, _tag);
-                if (pow(coord[0] - config.sources[i].source[1], 2) +
-                        pow(coord[1] - config.sources[i].source[2], 2) +
-                        pow(coord[2] - config.sources[i].source[3], 2) <
-                    pow(config.sources[i].source[4], 2))
-                {
-                    indice.push_back(n);
-                }
-            }
-            srcIndices.push_back(indice);
-        }
-
-        /** Observer */
         std::vector<std::vector<int>> obsIndices;
         std::vector<std::vector<double>> obsPtDistance;
-        for (int i = 0; i < config.observers.size(); ++i)
-        {
-            std::vector<int> indice;
-            std::vector<double> dist;
-            for (int n = 0; n < mesh.getNumNodes(); n++)
-            {
-                std::vector<double> coord, paramCoord;
-                int _dim, _tag;
-                gmsh::model::mesh::getNode(mesh.getElNodeTags()[n], coord, paramCoord, _dim, _tag);
-                double distance = sqrt(pow(coord[0] - config.observers[i][0], 2) +
-                                       pow(coord[1] - config.observers[i][1], 2) +
-                                       pow(coord[2] - config.observers[i][2], 2));
-                if (distance < config.observers[i][3])
-                {
-                    indice.push_back(n);
-                    dist.push_back(distance);
-                }
-            }
-            obsIndices.push_back(indice);
-            obsPtDistance.push_back(dist);
-        }
-
-        // for (int i = 0; i < obsIndices.size(); i++)
-        // {
-        //     for (int j = 0; j < obsIndices[i].size(); j++)
-        //     {
-        //         std::cout << obsIndices[i][j] << "\t";
-        //     }
-        //     std::cout << std::endl;
-        // }
-        // getchar();
+        locateSourcesAndObservers(mesh, config, srcIndices, obsIndices, obsPtDistance);
 
         /**
          * Main Loop : Time iteration
@@ -409,177 +383,730 @@ namespace solver
             obs_outfile[obs] << "time;density;pressure;velocity_x;velocity_y;velocity_z" << std::endl;
         }
 
+        // Integer step counts, so that the outputs are exactly every timeRate
+        // when it is a multiple of the time step
+        const int numSteps = (int)std::floor((config.timeEnd - config.timeStart) / config.timeStep * (1 + 1e-9)) + 1;
+        const int outputInterval = std::max(1, (int)std::ceil(config.timeRate / config.timeStep * (1 - 1e-9)));
+        std::vector<std::pair<int, double>> outputs; // Step and time of each saved solution
+
+        std::vector<ThreadScratch> scratch;
+        double residual[5];
         auto start = std::chrono::system_clock::now();
-        for (double t = config.timeStart, step = 0, tDisplay = 0; t <= config.timeEnd;
-             t += config.timeStep, tDisplay += config.timeStep, ++step)
+        auto start_time = start;
+
+#pragma omp parallel num_threads(config.numThreads)
         {
-            auto start_time = std::chrono::system_clock::now();
-            std::vector<double> residual(5, 0.0);
-            /**
-             *  Savings and prints
-             */
-            if (tDisplay >= config.timeRate || step == 0)
+#pragma omp single
+            scratch.resize(omp_get_num_threads());
+            ThreadScratch &threadScratch = scratch[omp_get_thread_num()];
+            threadScratch.allocate(config);
+
+            for (int step = 0; step < numSteps; ++step)
             {
-                tDisplay = 0;
+                const double t = config.timeStart + step * config.timeStep;
+
+                /**
+                 *  Savings and prints
+                 */
+                if (step % outputInterval == 0)
+                {
+                    /** [1] Save the solution */
+#pragma omp for schedule(static)
+                    for (int el = 0; el < mesh.getElNum(); ++el)
+                    {
+                        for (int eq = 0; eq < 4; ++eq)
+                            std::copy(u.el(eq, el), u.el(eq, el) + elNumNodes, uSaved.el(eq, el));
+                    }
+
+#pragma omp single
+                    {
+                        /** [2] Print and compute iteration time */
+                        auto end = std::chrono::system_clock::now();
+                        auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(end - start);
+                        screen_display::write_string("[" + std::to_string(t) + "/" + std::to_string(config.timeEnd) + "s] Step number : " + std::to_string(step) + ", Elapsed time: " + std::to_string(elapsed.count()) + "s");
+                        screen_display::write_string("time\t\tres_p\t\tres_rho\t\tres_vx\t\tres_vy\t\tres_vz\t\telapsed time", BOLDBLUE);
+                        std::string vtu_filename = "results/result" + std::to_string(step) + ".vtu";
+                        mesh.writeVTUb(vtu_filename, u);
+                        outputs.push_back({step, t});
+                    }
+                }
+
+#pragma omp single
+                {
+                    start_time = std::chrono::system_clock::now();
+                    for (int eq = 0; eq < 5; ++eq)
+                        residual[eq] = 0.0;
+
+                    /** Source */
+                    updateSources(u, config, srcIndices, t);
+                }
+
+                advance(threadScratch);
 
-/** [1] Copy solution to match GMSH format */
-// #pragma omp parallel for
-#pragma omp parallel for schedule(static) num_threads(config.numThreads)
+                /**
+                 * Compute residuals
+                 */
+#pragma omp for schedule(static) reduction(+ : residual[:5])
                 for (int el = 0; el < mesh.getElNum(); ++el)
                 {
                     for (int n = 0; n < mesh.getElNumNodes(); ++n)
                     {
                         int elN = el * elNumNodes + n;
-                        g_p[el][n] = u[0][elN];
-                        g_rho[el][n] = u[0][elN] / (config.c0 * config.c0);
-                        g_v[el][3 * n + 0] = u[1][elN];
-                        g_v[el][3 * n + 1] = u[2][elN];
-                        g_v[el][3 * n + 2] = u[3][elN];
+                        residual[0] += pow(uSaved[0][elN] - u[0][elN], 2);
+                        residual[1] += pow(uSaved[0][elN] / (config.c0 * config.c0) - u[0][elN] / (config.c0 * config.c0), 2);
+                        residual[2] += pow(uSaved[1][elN] - u[1][elN], 2);
+                        residual[3] += pow(uSaved[2][elN] - u[2][elN], 2);
+                        residual[4] += pow(uSaved[3][elN] - u[3][elN], 2);
                     }
                 }
-                // gmsh::view::addModelData(gp_viewTag, step, g_names[0], "ElementNodeData", elTags, g_p, t, 1);
-                // gmsh::view::addModelData(grho_viewTag, step, g_names[0], "ElementNodeData", elTags, g_rho, t, 1);
-                // gmsh::view::addModelData(gv_viewTag, step, g_names[0], "ElementNodeData", elTags, g_v, t, 3);
-
-                /** [2] Print and compute iteration time */
-                auto end = std::chrono::system_clock::now();
-                auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(end - start);
-                gmsh::logger::write("[" + std::to_string(t) + "/" + std::to_string(config.timeEnd) + "s] Step number : " + std::to_string((int)step) + ", Elapsed time: " + std::to_string(elapsed.count()) + "s");
-                screen_display::write_string("time\t\tres_p\t\tres_rho\t\tres_vx\t\tres_vy\t\tres_vz\t\telapsed time", BOLDBLUE);
-                // mesh.writeVTK("result.vtk");
-                std::string vtu_filename = "results/result" + std::to_string((int)step) + ".vtu";
-                mesh.writeVTUb(vtu_filename, u);
-                // mesh.writeVTK("result.vtk",u);
-            }
 
-            /** Source */
-            for (int src = 0; src < config.sources.size(); ++src)
-            {
-                if (config.sources[src].formula == "" && config.sources[src].data.empty())
-                {
-                    double amp = config.sources[src].source[5];
-                    double freq = config.sources[src].source[6];
-                    double phase = config.sources[src].source[7];
-                    double duration = config.sources[src].source[8];
-                    if (t < duration)
-                        for (int n = 0; n < srcIndices[src].size(); ++n)
-                            u[0][srcIndices[src][n]] = amp * sin(2 * M_PI * freq * t + phase);
-                }
-                else
+#pragma omp single
                 {
-                    if (config.sources[src].data.empty())
+                    outfile << t << ";";
+                    std::cout << std::scientific << t << "\t";
+                    auto end_time = std::chrono::system_clock::now();
+                    auto elapsed_time = std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time);
+                    for (int eq = 0; eq < 5; ++eq)
                     {
-                        double duration = config.sources[src].source[5];
-                        if (t < duration)
-                            for (int n = 0; n < srcIndices[src].size(); ++n)
-                                u[0][srcIndices[src][n]] = config.sources[src].value(t);
+                        residual[eq] /= (mesh.getElNum() * mesh.getElNumNodes());
+                        std::cout << std::scientific << residual[eq] << "\t";
+                        outfile << residual[eq] << ";";
                     }
-                    else
+                    std::cout << elapsed_time.count() * 1.0e-6 << " s" << std::endl;
+                    outfile << elapsed_time.count() * 1.0e-6 << std::endl;
+
+                    /**
+                     * get observers value
+                     * Inverse distance weight interpolation method
+                     */
+                    for (int obs = 0; obs < config.observers.size(); ++obs)
                     {
-                        for (int n = 0; n < srcIndices[src].size(); ++n)
-                            u[0][srcIndices[src][n]] = config.sources[src].interpolate_value(t);
+                        double p(0), rho(0), w_sum(0);
+                        std::vector<double> v = {0, 0, 0};
+                        for (int n = 0; n < obsIndices[obs].size(); ++n)
+                        {
+                            double R = config.observers[obs][3];                        //! influence sphere
+                            double w = 1.0 / (pow(obsPtDistance[obs][n], 2) + 1.0e-12); // fmax(1.0-obsPtDistance[obs][n]/R,0.0);//1.0 / pow(obsPtDistance[obs][n],2);
+                            p += u[0][obsIndices[obs][n]] * w;
+                            v[0] += u[1][obsIndices[obs][n]] * w;
+                            v[1] += u[2][obsIndices[obs][n]] * w;
+                            v[2] += u[3][obsIndices[obs][n]] * w;
+                            w_sum += w;
+                        }
+                        p /= w_sum;
+                        rho = p / pow(config.c0, 2);
+                        v[0] /= w_sum;
+                        v[1] /= w_sum;
+                        v[2] /= w_sum;
+                        data4wave[obs].push_back(p);
+                        obs_outfile[obs] << t << ";" << rho << ";" << p << ";" << v[0] << ";" << v[1] << ";" << v[2] << std::endl;
                     }
                 }
             }
+        }
+        for (int obs = 0; obs < config.observers.size(); ++obs)
+        {
+            io::writeWave(data4wave[obs], "results/observer_" + std::to_string(obs + 1) + ".wav", 1.0 / config.timeStep, 16, 1, 1);
+            io::writeFFT(data4wave[obs],config.timeStep,"results/observer_" + std::to_string(obs + 1));
+        }
+
+        outfile.close();
+        for (int obs = 0; obs < config.observers.size(); ++obs)
+            obs_outfile[obs].close();
+        mesh.writePVD("results.pvd", outputs);
+    }
+
+    /**
+     * Solve using forward explicit scheme. O(h)
+     *
+     * @param u initial nodal solution vector
+     * @param mesh
+     * @param config
+     */
+    void forwardEuler(SolutionField &u, Mesh &mesh, const Config &config)
+    {
+        timeLoop(u, mesh, config, [&](ThreadScratch &scratch)
+                 {
+                     /**
+                      * First Order Euler
+                      */
+                     mesh.updateFluxShared(u);
+                     numStep(mesh, config, u, u, 1, scratch);
+                 });
+    }
+
+    /**
+     * Solve using explicit Runge-Kutta integration method. O(h^4)
+     *
+     * @param u initial nodal solution vector
+     * @param mesh
+     * @param config
+     */
+    void rungeKutta(SolutionField &u, Mesh &mesh, const Config &config)
+    {
+        SolutionField k1(u), k2(u), k3(u), k4(u);
+
+        timeLoop(u, mesh, config, [&](ThreadScratch &scratch)
+                 {
+                     /**
+                      * Fourth order Runge-Kutta algorithm
+                      */
+                     /** [1] Step R-K */
+                     axpy(k1, u, 0, u);
+                     mesh.updateFluxShared(k1);
+                     numStep(mesh, config, k1, k1, 0, scratch);
+                     /** [2] Step R-K */
+                     axpy(k2, u, 0.5, k1);
+                     mesh.updateFluxShared(k2);
+                     numStep(mesh, config, k2, k2, 0, scratch);
+                     /** [3] Step R-K */
+                     axpy(k3, u, 0.5, k2);
+                     mesh.updateFluxShared(k3);
+                     numStep(mesh, config, k3, k3, 0, scratch);
+                     /** [4] Step R-K */
+                     axpy(k4, u, 1, k3);
+                     mesh.updateFluxShared(k4);
+                     numStep(mesh, config, k4, k4, 0, scratch);
+                     /** Concat results of R-K iterations */
+                     const int size = u.size();
+                     for (int eq = 0; eq < u.numVars(); ++eq)
+                     {
+                         double *ueq = u[eq];
+                         const double *k1eq = k1[eq], *k2eq = k2[eq], *k3eq = k3[eq], *k4eq = k4[eq];
+#pragma omp for simd schedule(static) nowait
+                         for (int i = 0; i < size; ++i)
+                             ueq[i] += (k1eq[i] + 2 * k2eq[i] + 2 * k3eq[i] + k4eq[i]) / 6.0;
+                     }
+#pragma omp barrier
+                 });
+    }
+
+    /**
+     * 2N-storage explicit Runge-Kutta schemes (Williamson form). Each stage i
+     * only needs the solution u and one register du:
+     *   du = A_i*du + dt*L(u),  u = u + B_i*du
+     * The spatial operator L does not depend on time (the sources are imposed
+     * at the beginning of the step), so the stage times are not needed.
+     */
+    struct LowStorageRK
+    {
+        std::string name;
+        std::vector<double> A;
+        std::vector<double> B;
+        double cfl; // Stable CFL number (see stableTimeStep)
+    };
 
-            /**
-             * Fourth order Runge-Kutta algorithm
-             */
-            k1 = k2 = k3 = k4 = u;
-            /** [1] Step R-K */
-            mesh.updateFlux(k1, Flux, config.v0, config.c0, config.rho0);
-            numStep(mesh, config, k1, Flux, 0);
-            for (int eq = 0; eq < u.size(); ++eq)
-                eigen::plusTimes(k2[eq].data(), k1[eq].data(), 0.5, numNodes);
-            /** [2] Step R-K */
-            mesh.updateFlux(k2, Flux, config.v0, config.c0, config.rho0);
-            numStep(mesh, config, k2, Flux, 0);
-            for (int eq = 0; eq < u.size(); ++eq)
-                eigen::plusTimes(k3[eq].data(), k2[eq].data(), 0.5, numNodes);
-            /** [3] Step R-K */
-            mesh.updateFlux(k3, Flux, config.v0, config.c0, config.rho0);
-            numStep(mesh, config, k3, Flux, 0);
-            for (int eq = 0; eq < u.size(); ++eq)
-                eigen::plusTimes(k4[eq].data(), k3[eq].data(), 1, numNodes);
-            /** [4] Step R-K */
-            mesh.updateFlux(k4, Flux, config.v0, config.c0, config.rho0);
-            numStep(mesh, config, k4, Flux, 0);
-            /** Concat results of R-K iterations */
-            // #pragma omp parallel for
-            for (int eq = 0; eq < u.size(); ++eq)
+    const std::vector<LowStorageRK> lowStorageSchemes = {
+        // Carpenter & Kennedy (1994), 5 stages, order 4
+        {"LSRK54",
+         {0.0,
+          -567301805773.0 / 1357537059087.0,
+          -2404267990393.0 / 2016746695238.0,
+          -3550918686646.0 / 2091501179385.0,
+          -1275806237668.0 / 842570457699.0},
+         {1432997174477.0 / 9575080441755.0,
+          5161836677717.0 / 13612068292357.0,
+          1720146321549.0 / 2090206949498.0,
+          3134564353537.0 / 4481467310338.0,
+          2277821191437.0 / 14882151754819.0},
+         4.9},
+        // Niegemann, Diehl & Busch (2012), 14 stages, order 4: stability
+        // region optimized for the spectra of upwind DG operators
+        {"LSRK144",
+         {0.0, -0.7188012108672410, -0.7785331173421570, -0.0053282796654044,
+          -0.8552979934029281, -3.9564138245774565, -1.5780575380587385,
+          -2.0837094552574054, -0.7483334182761610, -0.7032861106563359,
+          0.0013917096117681, -0.0932075369637460, -0.9514200470875948,
+          -7.1151571693922548},
+         {0.0367762454319673, 0.3136296607553959, 0.1531848691869027,
+          0.0030097086818182, 0.3326293790646110, 0.2440251405350864,
+          0.3718879239592277, 0.6204126221582444, 0.1524043173028741,
+          0.0760894927419266, 0.0077604214040978, 0.0024647284755382,
+          0.0780348340049386, 5.5059777270269628},
+         12.5},
+    };
+
+    bool isLowStorageRK(const std::string &name)
+    {
+        for (const LowStorageRK &scheme : lowStorageSchemes)
+            if (scheme.name == name)
+                return true;
+        return false;
+    }
+
+    /**
+     * Solve using a low-storage explicit Runge-Kutta scheme (see
+     * LowStorageRK), selected by config.timeIntMethod. O(h^4)
+     *
+     * @param u initial nodal solution vector
+     * @param mesh
+     * @param config
+     */
+    void lowStorageRungeKutta(SolutionField &u, Mesh &mesh, const Config &config)
+    {
+        const LowStorageRK *scheme = nullptr;
+        for (const LowStorageRK &s : lowStorageSchemes)
+            if (s.name == config.timeIntMethod)
+                scheme = &s;
+        if (!scheme)
+            Fatal_Error("Unknown low-storage Runge-Kutta scheme");
+
+        SolutionField du(u.numVars(), u.numEl(), u.elNumPts(), config.numThreads);
+
+        timeLoop(u, mesh, config, [&](ThreadScratch &scratch)
+                 {
+                     for (size_t i = 0; i < scheme->A.size(); ++i)
+                     {
+                         mesh.updateFluxShared(u);
+                         numStep(mesh, config, u, du, scheme->A[i], scratch);
+                         axpy(u, u, scheme->B[i], du);
+                     }
+                 });
+    }
+
+    bool isLocalTimeStepping(const std::string &name)
+    {
+        return name == "LTS-AB3";
+    }
+
+    /**
+     * Stable CFL number of a time integration method (see stableTimeStep),
+     * 0 if the method has no stable time step on DG discretizations.
+     */
+    double stabilityCfl(const std::string &method)
+    {
+        if (method == "Runge-Kutta")
+            return 3.0;
+        if (method == "LTS-AB3")
+            return 0.55;
+        for (const LowStorageRK &scheme : lowStorageSchemes)
+            if (scheme.name == method)
+                return scheme.cfl;
+        return 0;
+    }
+
+    /**
+     * Largest stable time step of an explicit scheme on the mesh:
+     * dt = CFL * min(r_el) / (c * (2p + 1)), with r_el the inscribed radius
+     * of the elements, c the largest wave speed and p the element order.
+     * The CFL number depends on the stability region of the scheme: it was
+     * measured on P1 and P2 triangles and P1 tetrahedra, the triangles giving
+     * the smallest values, and on the stretched triangles of a graded mesh
+     * (which lower the CFL number of LSRK144).
+     *
+     * @param mesh
+     * @param method time integration method
+     */
+    double stableTimeStep(Mesh &mesh, const std::string &method)
+    {
+        double minInRadius = std::numeric_limits<double>::max();
+        for (int el = 0; el < mesh.getElNum(); ++el)
+            minInRadius = std::min(minInRadius, mesh.elInRadius(el));
+        return stabilityCfl(method) * minInRadius / (mesh.getWaveSpeed() * (2 * mesh.getElOrder() + 1));
+    }
+
+    /**
+     * Largest stable time step of a single element (see stableTimeStep).
+     */
+    double elStableTimeStep(Mesh &mesh, int el, const std::string &method)
+    {
+        return stabilityCfl(method) * mesh.elInRadius(el) / (mesh.getWaveSpeed() * (2 * mesh.getElOrder() + 1));
+    }
+
+    /**
+     * Time step used by timeStep = auto: the largest stable time step times
+     * the safety factor, rounded down so that timeRate is a whole number of
+     * time steps.
+     *
+     * @param mesh
+     * @param config
+     */
+    double autoTimeStep(Mesh &mesh, const Config &config)
+    {
+        if (stabilityCfl(config.timeIntMethod) <= 0)
+            Fatal_Error("timeStep = auto is not available for this time integration method");
+
+        double stable = stableTimeStep(mesh, config.timeIntMethod);
+        if (isLocalTimeStepping(config.timeIntMethod))
+        {
+            // Time step of the coarsest level: the smallest one times the largest
+            // power of two stable on some element, within timeLevels levels
+            double maxStable = 0;
+            for (int el = 0; el < mesh.getElNum(); ++el)
+                maxStable = std::max(maxStable, elStableTimeStep(mesh, el, config.timeIntMethod));
+            int numLevels = 1;
+            while (numLevels < config.timeLevels && stable * (1 << numLevels) <= maxStable)
+                ++numLevels;
+            stable *= 1 << (numLevels - 1);
+        }
+        double dt = config.timeStepSafety * stable;
+        if (config.timeRate > 0)
+            dt = config.timeRate / std::ceil(config.timeRate / dt);
+        screen_display::write_value("Largest stable time step:", stable, "s", BLUE);
+        screen_display::write_value("Time step:", dt, "s", BLUE);
+        return dt;
+    }
+
+    /**
+     * Weights of the Adams-Bashforth scheme of order 1 to 3 over a fraction
+     * theta of its time step dt:
+     *   u(t + theta*dt) = u(t) + sum_j w_j * dt*L(u(t - j*dt)), j < order
+     * theta = 1 is the step of the scheme, theta < 1 its dense output, i.e. the
+     * integral of the polynomial interpolating the last values of dt*L(u).
+     */
+    void adamsBashforthWeights(int order, double theta, double w[3])
+    {
+        const double t2 = theta * theta, t3 = t2 * theta;
+        w[0] = w[1] = w[2] = 0;
+        if (order == 1)
+            w[0] = theta;
+        else if (order == 2)
+        {
+            w[0] = theta + t2 / 2;
+            w[1] = -t2 / 2;
+        }
+        else
+        {
+            w[0] = theta + 3 * t2 / 4 + t3 / 6;
+            w[1] = -t2 - t3 / 3;
+            w[2] = t2 / 4 + t3 / 6;
+        }
+    }
+
+    /**
+     * Power-of-two time levels of the local time stepping: the elements of
+     * level l advance with the time step 2^l * dt. The elements are grouped by
+     * batches of simd::width consecutive elements, the granularity of the
+     * element kernels, and a batch takes the level of its smallest element.
+     */
+    struct TimeLevels
+    {
+        int numLevels;
+        double dt;                          // Time step of level 0
+        std::vector<int> batchLevel;        // Level of each batch
+        std::vector<int> batches;           // Batch ids sorted by level
+        std::vector<int> levelEnd;          // Number of batches of level <= l at the beginning of batches
+        std::vector<std::vector<int>> halo; // Batches of level > l sharing a face with a batch of level <= l
+    };
+
+    /**
+     * Cluster the elements into time levels. config.timeStep is the time step
+     * of the coarsest level; the number of levels is the smallest one for
+     * which the time step of level 0 is stable on the smallest element, and
+     * each batch gets the coarsest level stable on its elements (with the
+     * safety factor timeStepSafety). The elements of the sources are put on
+     * level 0, where the sources are imposed at every substep, and the levels
+     * of two neighbouring batches differ by one at most. The faces of the mesh
+     * are sorted by level accordingly (see Mesh::setTimeLevels).
+     *
+     * @param mesh
+     * @param config
+     * @param srcIndices node ids of each source
+     */
+    TimeLevels buildTimeLevels(Mesh &mesh, const Config &config, std::vector<std::vector<int>> const &srcIndices)
+    {
+        const int W = simd::width(mesh.getSimdIsa());
+        const int numEl = mesh.getElNum();
+        const int numBatches = (numEl + W - 1) / W;
+        TimeLevels levels;
+
+        // Largest stable time step of each batch
+        std::vector<double> batchDt(numBatches, std::numeric_limits<double>::max());
+        for (int el = 0; el < numEl; ++el)
+            batchDt[el / W] = std::min(batchDt[el / W],
+                                       config.timeStepSafety * elStableTimeStep(mesh, el, config.timeIntMethod));
+        const double minDt = *std::min_element(batchDt.begin(), batchDt.end());
+
+        levels.numLevels = 1;
+        while (config.timeStep / (1 << (levels.numLevels - 1)) > minDt * (1 + 1e-9))
+            ++levels.numLevels;
+        if (levels.numLevels > config.timeLevels)
+            Fatal_Error("The time step needs more than timeLevels time levels to be stable");
+        levels.dt = config.timeStep / (1 << (levels.numLevels - 1));
+
+        levels.batchLevel.resize(numBatches);
+        for (int b = 0; b < numBatches; ++b)
+        {
+            int level = (int)std::floor(std::log2(batchDt[b] / levels.dt * (1 + 1e-9)));
+            levels.batchLevel[b] = std::max(0, std::min(levels.numLevels - 1, level));
+        }
+        for (auto const &nodes : srcIndices)
+            for (int n : nodes)
+                levels.batchLevel[n / mesh.getElNumNodes() / W] = 0;
+
+        // Visit the neighbouring elements (through the interior faces) of an element
+        auto forNeighbours = [&](int el, auto visit)
+        {
+            for (int i = 0; i < mesh.getFNumPerEl(); ++i)
             {
-                for (int i = 0; i < numNodes; ++i)
-                {
-                    // #pragma omp atomic
-                    u[eq][i] += (k1[eq][i] + 2 * k2[eq][i] + 2 * k3[eq][i] + k4[eq][i]) / 6.0;
-                }
+                int f = mesh.elFId(el, i);
+                uint32_t nbr = (mesh.fNbrElId(f, 0) == (uint32_t)el) ? mesh.fNbrElId(f, 1) : mesh.fNbrElId(f, 0);
+                if (nbr < (uint32_t)numEl)
+                    visit(nbr);
             }
+        };
 
-#pragma omp parallel for schedule(static) num_threads(config.numThreads)
-            for (int el = 0; el < mesh.getElNum(); ++el)
+        // Neighbouring batches: one level of difference at most
+        bool changed = true;
+        while (changed)
+        {
+            changed = false;
+            for (int el = 0; el < numEl; ++el)
+                forNeighbours(el, [&](int nbr)
+                              {
+                                  int &level = levels.batchLevel[el / W];
+                                  if (level > levels.batchLevel[nbr / W] + 1)
+                                  {
+                                      level = levels.batchLevel[nbr / W] + 1;
+                                      changed = true;
+                                  } });
+        }
+
+        std::vector<int> elLevel(numEl);
+        for (int el = 0; el < numEl; ++el)
+            elLevel[el] = levels.batchLevel[el / W];
+        mesh.setTimeLevels(elLevel, levels.numLevels);
+
+        levels.batches.resize(numBatches);
+        for (int b = 0; b < numBatches; ++b)
+            levels.batches[b] = b;
+        std::stable_sort(levels.batches.begin(), levels.batches.end(),
+                         [&](int b1, int b2) { return levels.batchLevel[b1] < levels.batchLevel[b2]; });
+        levels.levelEnd.assign(levels.numLevels, 0);
+        for (int b = 0; b < numBatches; ++b)
+            for (int l = levels.batchLevel[b]; l < levels.numLevels; ++l)
+                ++levels.levelEnd[l];
+
+        levels.halo.resize(levels.numLevels);
+        for (int el = 0; el < numEl; ++el)
+            forNeighbours(el, [&](int nbr)
+                          {
+                              for (int l = levels.batchLevel[nbr / W]; l < levels.batchLevel[el / W]; ++l)
+                                  levels.halo[l].push_back(el / W); });
+        for (std::vector<int> &halo : levels.halo)
+        {
+            std::sort(halo.begin(), halo.end());
+            halo.erase(std::unique(halo.begin(), halo.end()), halo.end());
+        }
+
+        // Batch updates per time step of level 0, numBatches with a global time step
+        double cost = 0;
+        screen_display::write_value("Local time stepping, time levels:", levels.numLevels, "", BLUE);
+        for (int l = 0; l < levels.numLevels; ++l)
+        {
+            int numLevelBatches = levels.levelEnd[l] - (l > 0 ? levels.levelEnd[l - 1] : 0);
+            cost += (double)numLevelBatches / (1 << l);
+            screen_display::write_value("  Level " + std::to_string(l) + ", " +
+                                            std::to_string(std::count(elLevel.begin(), elLevel.end(), l)) +
+                                            " elements, time step:",
+                                        levels.dt * (1 << l), "s", BLUE);
+        }
+        screen_display::write_value("Speedup over a global time step:", numBatches / cost, "x", BLUE);
+        return levels;
+    }
+
+    /**
+     * Solve using multirate Adams-Bashforth local time stepping (LTS-AB3).
+     * O(h^3)
+     *
+     * The elements are clustered into power-of-two time levels (see
+     * buildTimeLevels) and each level advances with its own time step by the
+     * third order Adams-Bashforth scheme, so that the element updates per unit
+     * of time are sum(N_l / dt_l) instead of N / dt_0. A time step of the
+     * coarsest level is made of 2^(L-1) substeps of level 0; at substep n the
+     * levels l with 2^l dividing n are active. The active elements are coupled
+     * to the others through the numerical flux: the solution of an inactive
+     * neighbour at the current time is predicted by the dense output of its
+     * last Adams-Bashforth step. Only the faces, elements and neighbours of
+     * the active levels are visited. The scheme starts with first and
+     * second order steps. The elements are processed by batches without
+     * the blocked element update (elBlockSize).
+     *
+     * @param u initial nodal solution vector
+     * @param mesh
+     * @param config
+     */
+    void localTimeStepping(SolutionField &u, Mesh &mesh, const Config &config)
+    {
+        const std::vector<std::vector<int>> srcIndices = locateSources(mesh, config);
+        const TimeLevels levels = buildTimeLevels(mesh, config, srcIndices);
+        const int W = simd::width(mesh.getSimdIsa());
+        const int numSubsteps = 1 << (levels.numLevels - 1);
+
+        // Solution at the current substep and last three steps dt_l*L(u) of each element
+        SolutionField uNow(u.numVars(), u.numEl(), u.elNumPts(), config.numThreads);
+        std::vector<SolutionField> history(3, uNow);
+        long step = 0; // Time steps of the coarsest level done
+
+        // y = u + sum_j w_j * history of the update - j, on the elements of batch b
+        auto batchCombine = [&](SolutionField &y, int b, long update, int order, const double *w)
+        {
+            const size_t i0 = (size_t)b * W * u.elNumPts();
+            const size_t i1 = (size_t)std::min((b + 1) * W, mesh.getElNum()) * u.elNumPts();
+            for (int eq = 0; eq < u.numVars(); ++eq)
             {
-                for (int n = 0; n < mesh.getElNumNodes(); ++n)
+                double *yeq = y[eq];
+                const double *ueq = u[eq];
+                for (size_t i = i0; i < i1; ++i)
                 {
-                    int elN = el * elNumNodes + n;
-#pragma omp atomic update
-                    residual[0] += pow(g_p[el][n] - u[0][elN], 2);
-#pragma omp atomic update
-                    residual[1] += pow(g_rho[el][n] - u[0][elN] / (config.c0 * config.c0), 2);
-#pragma omp atomic update
-                    residual[2] += pow(g_v[el][3 * n + 0] - u[1][elN], 2);
-#pragma omp atomic update
-                    residual[3] += pow(g_v[el][3 * n + 1] - u[2][elN], 2);
-#pragma omp atomic update
-                    residual[4] += pow(g_v[el][3 * n + 2] - u[3][elN], 2);
+                    double v = ueq[i];
+                    for (int j = 0; j < order; ++j)
+                        v += w[j] * history[(update - j) % 3][eq][i];
+                    yeq[i] = v;
                 }
             }
-            outfile << t << ";";
-            std::cout << std::scientific << t << "\t";
-            auto end_time = std::chrono::system_clock::now();
-            auto elapsed_time = std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time);
-            for (int eq = 0; eq < residual.size(); ++eq)
-            {
-                residual[eq] /= (mesh.getElNum() * mesh.getElNumNodes());
-                std::cout << std::scientific << residual[eq] << "\t";
-                outfile << residual[eq] << ";";
-            }
-            std::cout << elapsed_time.count() * 1.0e-6 << " s" << std::endl;
-            outfile << elapsed_time.count() * 1.0e-6 << std::endl;
-            /**
-             * get observers value
-             * Inverse distance weight interpolation method
-             */
-            for (int obs = 0; obs < config.observers.size(); ++obs)
+        };
+
+        timeLoop(u, mesh, config, [&](ThreadScratch &scratch)
+                 {
+                     for (int n = 0; n < numSubsteps; ++n)
+                     {
+                         const long substep = step * numSubsteps + n;
+                         int active = levels.numLevels - 1; // Coarsest active level
+                         while (n % (1 << active))
+                             --active;
+
+                         if (n > 0)
+                         {
+#pragma omp single
+                             updateSources(u, config, srcIndices, config.timeStart + step * config.timeStep + n * levels.dt);
+                         }
+
+                         /** [1] Solution at the current time: active elements and predicted neighbours */
+                         const double none[3] = {0, 0, 0};
+#pragma omp for schedule(static) nowait
+                         for (int i = 0; i < levels.levelEnd[active]; ++i)
+                             batchCombine(uNow, levels.batches[i], 0, 0, none);
+                         if (active < levels.numLevels - 1)
+                         {
+#pragma omp for schedule(static) nowait
+                             for (size_t i = 0; i < levels.halo[active].size(); ++i)
+                             {
+                                 int b = levels.halo[active][i];
+                                 int l = levels.batchLevel[b];
+                                 long update = substep >> l; // Last update of the batch, ending after the current time
+                                 int order = (int)std::min(3L, update + 1);
+                                 double w[3], wNow[3];
+                                 adamsBashforthWeights(order, 1.0, w);
+                                 adamsBashforthWeights(order, (double)(substep - (update << l)) / (1 << l), wNow);
+                                 for (int j = 0; j < 3; ++j)
+                                     w[j] = wNow[j] - w[j];
+                                 batchCombine(uNow, b, update, order, w);
+                             }
+                         }
+#pragma omp barrier
+
+                         /** [2] Ghost and numerical fluxes of the faces of the active elements */
+                         mesh.updateFluxShared(uNow, active);
+                         mesh.precomputeFluxShared(uNow, active);
+
+                         /** [3] Adams-Bashforth step of the active elements */
+#pragma omp for schedule(static)
+                         for (int i = 0; i < levels.levelEnd[active]; ++i)
+                         {
+                             int b = levels.batches[i];
+                             int l = levels.batchLevel[b];
+                             long update = substep >> l;
+                             int order = (int)std::min(3L, update + 1);
+                             double w[3];
+                             adamsBashforthWeights(order, 1.0, w);
+                             batchStep(mesh, uNow, history[update % 3], 0, levels.dt * (1 << l), b, scratch);
+                             batchCombine(u, b, update, order, w);
+                         }
+                     }
+#pragma omp single
+                     ++step;
+                 });
+    }
+
+    /**
+     * Time the update kernel of the affine elements for each instruction set
+     * supported by the CPU, generic and specialized on the element type, and
+     * print its throughput in DOF updates (one equation at one node) per
+     * second. The solution is left untouched.
+     *
+     * @param u nodal solution vector
+     * @param mesh
+     * @param config
+     */
+    void benchmarkKernels(SolutionField &u, Mesh &mesh, const Config &config)
+    {
+        const int numReps = 20;
+        elNumNodes = mesh.getElNumNodes();
+        SolutionField v(u);
+        std::vector<double> zeroFlux(4 * elNumNodes * simd::maxWidth, 0.0);
+
+        screen_display::write_string("Element kernels benchmark", GREEN);
+        for (simd::Isa isa : {simd::Isa::Scalar, simd::Isa::AVX2, simd::Isa::AVX512})
+        for (bool specialized : {false, true})
+        {
+            if (!simd::isSupported(isa) || (specialized && !simd::isSpecialized(mesh.getElDim(), elNumNodes)))
+                continue;
+            const simd::AffineUpdateKernel affineUpdate = specialized
+                                                              ? simd::affineUpdate(isa, mesh.getElDim(), elNumNodes, mesh.isQuiescent())
+                                                              : simd::affineUpdate(isa, mesh.isQuiescent());
+            const int W = simd::width(isa);
+            const int numBatches = mesh.getElNum() / W;
+
+            size_t numDofUpdates = 0;
+            auto start = std::chrono::system_clock::now();
+            for (int rep = 0; rep < numReps; ++rep)
             {
-                double p(0), rho(0), w_sum(0);
-                std::vector<double> v = {0, 0, 0};
-                for (int n = 0; n < obsIndices[obs].size(); ++n)
+#pragma omp parallel for schedule(static) reduction(+ : numDofUpdates) num_threads(config.numThreads)
+                for (int b = 0; b < numBatches; ++b)
                 {
-                    double R = config.observers[obs][3];                        //! influence sphere
-                    double w = 1.0 / (pow(obsPtDistance[obs][n], 2) + 1.0e-12); // fmax(1.0-obsPtDistance[obs][n]/R,0.0);//1.0 / pow(obsPtDistance[obs][n],2);
-                    p += u[0][obsIndices[obs][n]] * w;
-                    v[0] += u[1][obsIndices[obs][n]] * w;
-                    v[1] += u[2][obsIndices[obs][n]] * w;
-                    v[2] += u[3][obsIndices[obs][n]] * w;
-                    w_sum += w;
+                    int el0 = b * W;
+                    bool affine = true;
+                    for (int l = 0; affine && l < W; ++l)
+                        affine = mesh.elIsAffine(el0 + l);
+                    if (!affine)
+                        continue;
+                    simd::AffineBatch batch;
+                    mesh.getAffineBatch(el0, W, v, batch);
+                    batch.elFlux = zeroFlux.data();
+                    batch.dt = config.timeStep;
+                    batch.beta = 1;
+                    affineUpdate(batch);
+                    numDofUpdates += 4 * W * elNumNodes;
                 }
-                p /= w_sum;
-                rho = p / pow(config.c0, 2);
-                v[0] /= w_sum;
-                v[1] /= w_sum;
-                v[2] /= w_sum;
-                data4wave[obs].push_back(p);
-                obs_outfile[obs] << t << ";" << rho << ";" << p << ";" << v[0] << ";" << v[1] << ";" << v[2] << std::endl;
             }
+            auto end = std::chrono::system_clock::now();
+            double elapsed = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() * 1.0e-6;
+            screen_display::write_value("  " + simd::name(isa) + (specialized ? " specialized" : " generic") + ", " +
+                                            std::to_string(W) + " element(s) per batch:",
+                                        numDofUpdates / elapsed, "DOF/s", BLUE);
         }
-        for (int obs = 0; obs < config.observers.size(); ++obs)
+    }
+
+    /**
+     * Time the numerical flux through all the faces (precomputeFlux) with
+     * 1 to numThreads threads and print the time per call, the speedup and
+     * the parallel efficiency with respect to one thread.
+     *
+     * @param u nodal solution vector
+     * @param mesh
+     * @param config
+     */
+    void benchmarkFaceFlux(SolutionField &u, Mesh &mesh, const Config &config)
+    {
+        const int numReps = 20;
+        const int maxThreads = config.numThreads > 0 ? config.numThreads : omp_get_max_threads();
+
+        screen_display::write_string("Face flux benchmark", GREEN);
+        double serialTime = 0;
+        for (int numThreads = 1; numThreads <= maxThreads; ++numThreads)
         {
-            io::writeWave(data4wave[obs], "results/observer_" + std::to_string(obs + 1) + ".wav", 1.0 / config.timeStep, 16, 1, 1);
-            io::writeFFT(data4wave[obs],config.timeStep,"results/observer_" + std::to_string(obs + 1));
+            mesh.precomputeFlux(u, numThreads); // Warm up the thread pool
+            auto start = std::chrono::system_clock::now();
+            for (int rep = 0; rep < numReps; ++rep)
+                mesh.precomputeFlux(u, numThreads);
+            auto end = std::chrono::system_clock::now();
+            double elapsed = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() * 1.0e-6 / numReps;
+            if (numThreads == 1)
+                serialTime = elapsed;
+            screen_display::write_value("  " + std::to_string(numThreads) + " thread(s):", elapsed, "s", BLUE);
+            screen_display::write_value("    speedup:", serialTime / elapsed, "x", BLUE);
+            screen_display::write_value("    efficiency:", 100.0 * serialTime / elapsed / numThreads, "%", BLUE);
         }
-
-        outfile.close();
-        for (int obs = 0; obs < config.observers.size(); ++obs)
-            obs_outfile[obs].close();
     }
 }
@@ -0,0 +1,220 @@
+#include <Eigen/Dense>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "spatialIndex.h"
+
+void SpatialIndex::build(std::vector<double> const &nodeCoords, int elNumNodes, int elNumVertices, int dim)
+{
+    size_t numNodes = nodeCoords.size() / 3;
+    size_t numEl = numNodes / elNumNodes;
+    m_dim = dim;
+    m_elNumVertices = elNumVertices;
+
+    /**
+     * [1] Grid dimensions: the cell size is the mean element size,
+     *     computed along the non degenerated directions only.
+     */
+    double hi[3];
+    for (int x = 0; x < 3; ++x)
+    {
+        m_lo[x] = std::numeric_limits<double>::max();
+        hi[x] = std::numeric_limits<double>::lowest();
+    }
+    for (size_t n = 0; n < numNodes; ++n)
+    {
+        for (int x = 0; x < 3; ++x)
+        {
+            m_lo[x] = std::min(m_lo[x], nodeCoords[n * 3 + x]);
+            hi[x] = std::max(hi[x], nodeCoords[n * 3 + x]);
+        }
+    }
+
+    double volume = 1.0;
+    int numDir = 0;
+    for (int x = 0; x < 3; ++x)
+    {
+        if (hi[x] - m_lo[x] > 0)
+        {
+            volume *= hi[x] - m_lo[x];
+            numDir++;
+        }
+    }
+    double h = (numDir > 0 && numEl > 0) ? std::pow(volume / numEl, 1.0 / numDir) : 1.0;
+    for (int x = 0; x < 3; ++x)
+    {
+        double extent = hi[x] - m_lo[x];
+        m_numCells[x] = (extent > 0) ? std::max(1, (int)std::ceil(extent / h)) : 1;
+        m_cellSize[x] = (extent > 0) ? extent / m_numCells[x] : 1.0;
+    }
+    size_t numCells = (size_t)m_numCells[0] * m_numCells[1] * m_numCells[2];
+
+    /**
+     * [2] Nodes: counting sort by cell. Nodes are visited in ascending
+     *     order so that each cell lists its nodes in ascending order.
+     */
+    std::vector<size_t> nodeCell(numNodes);
+    m_nodeCellStart.assign(numCells + 1, 0);
+    for (size_t n = 0; n < numNodes; ++n)
+    {
+        int c[3];
+        getCellRange(&nodeCoords[n * 3], &nodeCoords[n * 3], c, c);
+        nodeCell[n] = cellId(c[0], c[1], c[2]);
+        m_nodeCellStart[nodeCell[n] + 1]++;
+    }
+    for (size_t c = 0; c < numCells; ++c)
+        m_nodeCellStart[c + 1] += m_nodeCellStart[c];
+
+    std::vector<size_t> fill(m_nodeCellStart.begin(), m_nodeCellStart.end() - 1);
+    m_nodeIds.resize(numNodes);
+    m_nodeCoords.resize(numNodes * 3);
+    for (size_t n = 0; n < numNodes; ++n)
+    {
+        size_t pos = fill[nodeCell[n]]++;
+        m_nodeIds[pos] = n;
+        std::copy(&nodeCoords[n * 3], &nodeCoords[n * 3] + 3, &m_nodeCoords[pos * 3]);
+    }
+
+    /**
+     * [3] Elements: each element is registered in every cell
+     *     overlapped by the bounding box of its nodes.
+     */
+    std::vector<int> elCellRange(numEl * 6);
+    m_elCellStart.assign(numCells + 1, 0);
+    m_elVertexCoords.resize(numEl * m_elNumVertices * 3);
+    for (size_t el = 0; el < numEl; ++el)
+    {
+        double elLo[3], elHi[3];
+        for (int x = 0; x < 3; ++x)
+        {
+            elLo[x] = std::numeric_limits<double>::max();
+            elHi[x] = std::numeric_limits<double>::lowest();
+        }
+        for (int n = 0; n < elNumNodes; ++n)
+        {
+            for (int x = 0; x < 3; ++x)
+            {
+                elLo[x] = std::min(elLo[x], nodeCoords[(el * elNumNodes + n) * 3 + x]);
+                elHi[x] = std::max(elHi[x], nodeCoords[(el * elNumNodes + n) * 3 + x]);
+            }
+        }
+        std::copy(&nodeCoords[el * elNumNodes * 3], &nodeCoords[el * elNumNodes * 3] + m_elNumVertices * 3,
+                  &m_elVertexCoords[el * m_elNumVertices * 3]);
+
+        int *cLo = &elCellRange[el * 6], *cHi = &elCellRange[el * 6 + 3];
+        getCellRange(elLo, elHi, cLo, cHi);
+        for (int k = cLo[2]; k <= cHi[2]; ++k)
+            for (int j = cLo[1]; j <= cHi[1]; ++j)
+                for (int i = cLo[0]; i <= cHi[0]; ++i)
+                    m_elCellStart[cellId(i, j, k) + 1]++;
+    }
+    for (size_t c = 0; c < numCells; ++c)
+        m_elCellStart[c + 1] += m_elCellStart[c];
+
+    fill.assign(m_elCellStart.begin(), m_elCellStart.end() - 1);
+    m_elIds.resize(m_elCellStart[numCells]);
+    for (size_t el = 0; el < numEl; ++el)
+    {
+        int *cLo = &elCellRange[el * 6], *cHi = &elCellRange[el * 6 + 3];
+        for (int k = cLo[2]; k <= cHi[2]; ++k)
+            for (int j = cLo[1]; j <= cHi[1]; ++j)
+                for (int i = cLo[0]; i <= cHi[0]; ++i)
+                    m_elIds[fill[cellId(i, j, k)]++] = el;
+    }
+}
+
+/**
+ * Cells overlapped by the box [lo, hi], clamped to the grid. A non finite
+ * bound is never cast to an integer: its cell index is set to 0.
+ *
+ * @return false if a bound of the box is not finite
+ */
+bool SpatialIndex::getCellRange(const double *lo, const double *hi, int *cellLo, int *cellHi) const
+{
+    bool finite = true;
+    for (int x = 0; x < 3; ++x)
+    {
+        double l = std::floor((lo[x] - m_lo[x]) / m_cellSize[x]);
+        double h = std::floor((hi[x] - m_lo[x]) / m_cellSize[x]);
+        if (!std::isfinite(l) || !std::isfinite(h))
+        {
+            cellLo[x] = cellHi[x] = 0;
+            finite = false;
+            continue;
+        }
+        cellLo[x] = (int)std::min(std::max(l, 0.0), m_numCells[x] - 1.0);
+        cellHi[x] = (int)std::min(std::max(h, 0.0), m_numCells[x] - 1.0);
+    }
+    return finite;
+}
+
+void SpatialIndex::radiusSearch(const double *x, double radius, std::vector<size_t> &nodeIds) const
+{
+    nodeIds.clear();
+    if (!(radius >= 0))
+        return;
+    double lo[3] = {x[0] - radius, x[1] - radius, x[2] - radius};
+    double hi[3] = {x[0] + radius, x[1] + radius, x[2] + radius};
+    int cLo[3], cHi[3];
+    if (!getCellRange(lo, hi, cLo, cHi))
+        return;
+
+    for (int k = cLo[2]; k <= cHi[2]; ++k)
+        for (int j = cLo[1]; j <= cHi[1]; ++j)
+            for (int i = cLo[0]; i <= cHi[0]; ++i)
+            {
+                size_t c = cellId(i, j, k);
+                for (size_t pos = m_nodeCellStart[c]; pos < m_nodeCellStart[c + 1]; ++pos)
+                {
+                    const double *p = &m_nodeCoords[pos * 3];
+                    double dist2 = (p[0] - x[0]) * (p[0] - x[0]) +
+                                   (p[1] - x[1]) * (p[1] - x[1]) +
+                                   (p[2] - x[2]) * (p[2] - x[2]);
+                    if (dist2 < radius * radius)
+                        nodeIds.push_back(m_nodeIds[pos]);
+                }
+            }
+    std::sort(nodeIds.begin(), nodeIds.end());
+}
+
+long SpatialIndex::locateElement(const double *x) const
+{
+    int c[3];
+    if (!getCellRange(x, x, c, c))
+        return -1;
+    size_t cell = cellId(c[0], c[1], c[2]);
+    for (size_t pos = m_elCellStart[cell]; pos < m_elCellStart[cell + 1]; ++pos)
+    {
+        if (isInElement(m_elIds[pos], x))
+            return (long)m_elIds[pos];
+    }
+    return -1;
+}
+
+/**
+ * Barycentric coordinates test. The system T * lambda = x - v0, where the
+ * columns of T are the edges (v_i - v0), is solved in the element plane.
+ */
+bool SpatialIndex::isInElement(size_t el, const double *x) const
+{
+    const double tol = 1.0e-10;
+    const double *v = &m_elVertexCoords[el * m_elNumVertices * 3];
+    Eigen::Matrix3d T = Eigen::Matrix3d::Identity();
+    Eigen::Vector3d b(x[0] - v[0], x[1] - v[1], x[2] - v[2]);
+    for (int i = 0; i < m_dim; ++i)
+    {
+        for (int r = 0; r < 3; ++r)
+            T(r, i) = v[(i + 1) * 3 + r] - v[r];
+    }
+    Eigen::VectorXd lambda = T.topLeftCorner(m_dim, m_dim).partialPivLu().solve(b.head(m_dim));
+
+    double sum = 0;
+    for (int i = 0; i < m_dim; ++i)
+    {
+        if (lambda(i) < -tol)
+            return false;
+        sum += lambda(i);
+    }
+    return sum <= 1.0 + tol;
+}
@@ -24,6 +24,10 @@ extern "C"
     // Matrix/vector product:  y := alpha*A*x + beta*y,
     void dgemv_(char &TRANS, int &M, int &N, double &a, double *A,
                 int &LDA, double *X, int &INCX, double &beta, double *Y, int &INCY);
+
+    // Matrix/matrix product:  C := alpha*op(A)*op(B) + beta*C
+    void dgemm_(char &TRANSA, char &TRANSB, int &M, int &N, int &K, double &alpha, double *A, int &LDA,
+                double *B, int &LDB, double &beta, double *C, int &LDC);
 }
 
 //! added by Sofiane KHELLADI in 11/03/2022 /////////////////////
@@ -350,6 +354,14 @@ namespace lapack
         dgemv_(TRANS, N, N, alpha, A, N, X, INC, beta, Y, INC);
     }
 
+    // Matrix/matrix product:  C := alpha*A*B + beta*C
+    // A (M*K) is row major, B (K*N) and C (M*N) are column major.
+    void gemm(double *A, double *B, double *C, double alpha, double beta, int M, int N, int K)
+    {
+        char TRANSA = 'T', TRANSB = 'N';
+        dgemm_(TRANSA, TRANSB, M, N, K, alpha, A, K, B, K, beta, C, M);
+    }
+
     // Dot product between 2 vectors
     double dot(double *A, double *B, int N)
     {
@@ -411,6 +423,20 @@ namespace eigen
         Y_eigen = beta * Y_eigen + alpha * A_eigen * X_eigen;
     }
 
+    // Matrix/matrix product:  C := alpha*A*B + beta*C
+    // A (M*K) is row major, B (K*N) and C (M*N) are column major.
+    void gemm(double *A, double *B, double *C, double alpha, double beta, int M, int N, int K)
+    {
+        Eigen::Map<Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>> A_eigen(A, M, K);
+        Eigen::Map<Eigen::MatrixXd> B_eigen(B, K, N);
+        Eigen::Map<Eigen::MatrixXd> C_eigen(C, M, N);
+        if (beta == 0)
+            C_eigen.setZero();
+        else
+            C_eigen *= beta;
+        C_eigen.noalias() += alpha * A_eigen * B_eigen;
+    }
+
     // Dot product between 2 vectors
     double dot(double *A, double *B, int N)
     {